@@ -0,0 +1,63 @@
+--[[
+Benchmark for the parser matching VM.
+
+Parses every Nelua source of the standard library and the tests many times,
+reporting the parsing throughput, then compares the short comment rule
+compiled to a span over all chars but line breaks against the generic
+`(!LINEBREAK .)*` loop.
+Run with `nelua --script benchmarks/parser_bench.lua`.
+To compare against the plain switch dispatch of the VM,
+rebuild the interpreter with `make clean default MYCFLAGS=-DLPEG_USE_JUMPTABLE=0`.
+]]
+
+local lpeg = require 'lpeglabel'
+local lfs = require 'lfs'
+local fs = require 'nelua.utils.fs'
+local nanotimer = require 'nelua.utils.nanotimer'
+local syntaxdefs = require 'nelua.syntaxdefs'
+require 'nelua.aster'
+
+local NROUNDS = 20
+
+-- Load the corpus.
+local corpus = {}
+local nbytes = 0
+for _,dir in ipairs{'lib', 'tests'} do
+  for filename in lfs.dir(dir) do
+    if filename:match('%.nelua$') then
+      local content = fs.readfile(fs.join(dir, filename))
+      corpus[#corpus+1] = content
+      nbytes = nbytes + #content
+    end
+  end
+end
+
+local function report(name, elapsed, size)
+  print(string.format('%-12s %8.2f ms %8.2f MB/s', name, elapsed / NROUNDS, size * NROUNDS / (elapsed * 1e3)))
+end
+
+do -- whole grammar
+  local patt = syntaxdefs.patt
+  local timer = nanotimer()
+  for _=1,NROUNDS do
+    for i=1,#corpus do
+      assert(patt:match(corpus[i]))
+    end
+  end
+  report('parse', timer:elapsed(), nbytes)
+end
+
+do -- short comments
+  local linebreak = lpeg.S'\n\r'
+  local text = string.rep(string.rep('-', 70)..'\n', 20000)
+  local span = ((1 - linebreak)^0 * linebreak)^0 * -1
+  local loop = ((-linebreak * 1)^0 * linebreak)^0 * -1
+  for _,bench in ipairs{{'span', span}, {'loop', loop}} do
+    local name, patt = bench[1], bench[2]
+    local timer = nanotimer()
+    for _=1,NROUNDS do
+      assert(patt:match(text))
+    end
+    report(name, timer:elapsed(), #text)
+  end
+end
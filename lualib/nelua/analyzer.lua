@@ -9,6 +9,7 @@ local Attr = require 'nelua.attr'
 local Symbol = require 'nelua.symbol'
 local types = require 'nelua.types'
 local bn = require 'nelua.utils.bn'
+local stringer = require 'nelua.utils.stringer'
 local except = require 'nelua.utils.except'
 local preprocessor = require 'nelua.preprocessor'
 local builtins = require 'nelua.builtins'
@@ -16,6 +17,7 @@ local config = require 'nelua.configer'.get()
 local console = require 'nelua.utils.console'
 local nanotimer = require 'nelua.utils.nanotimer'
 local aster = require 'nelua.aster'
+local evaluator = require 'nelua.evaluator'
 local analyzer = {}
 local luatype = type
 
@@ -1527,6 +1529,23 @@ local function visitor_Call(context, node, argnodes, calleetype, calleesym, call
       if calleetype then
         attr.type, attr.value = calleetype:get_return_type_and_value(1)
         sideeffect = calleetype.sideeffect
+        if calleesym and calleesym.comptimeeval and not calleeobjnode and not attr.evalfailed and
+           not context.pragmas.nocomptimeeval then
+          -- try to evaluate the call at compile time
+          local value = attr.evalvalue
+          if value == nil then
+            local final
+            value, final = evaluator.eval_call(calleesym, argnodes)
+            attr.evalvalue = value
+            if value == nil and final then
+              attr.evalfailed = true -- would give up again, do not retry in the next traversals
+            end
+          end
+          if value ~= nil then
+            attr.comptime = true
+            attr.value = value
+          end
+        end
         if calleetype.symbol then
           calleetype.symbol:add_use_by(context.state.funcscope.funcsym)
         end
@@ -1946,19 +1965,32 @@ function visitors.Switch(context, node)
   local scope = context:push_forked_cleaned_scope(node)
   scope.is_switch = true
   local valtype = valnode.attr.type
-  if valtype and not (valtype.is_any or valtype.is_integral) then
+  local isstring = valtype and valtype.is_string
+  if valtype and not (valtype.is_any or valtype.is_integral or isstring) then
     valnode:raisef(
-      "`switch` statement must be convertible to an integral type, but got type `%s` (non integral)",
+      "`switch` statement must be convertible to an integral type or be a string, but got type `%s`",
       valtype)
   end
   local done = valnode.done
+  local casestrs = isstring and {}
   for i=1,#casepairs,2 do
     local caseexprs, caseblock = casepairs[i], casepairs[i+1]
     for j=1,#caseexprs do
       local casenode = caseexprs[j]
       context:traverse_node(casenode)
-      if not (casenode.attr.type and casenode.attr.type.is_integral and
-             (casenode.attr.comptime or casenode.attr.cimport)) then
+      local caseattr = casenode.attr
+      if isstring then
+        if not (caseattr.type and caseattr.type.is_stringy and caseattr.comptime) then
+          casenode:raisef("`case` statement must evaluate to a compile time string value")
+        end
+        local s = caseattr.value
+        if casestrs[s] then
+          casenode:raisef("duplicate `case` value '%s' in `switch` statement", s)
+        end
+        casestrs[s] = true
+        casestrs[#casestrs+1] = s
+      elseif not (caseattr.type and caseattr.type.is_integral and
+             (caseattr.comptime or caseattr.cimport)) then
         casenode:raisef("`case` statement must evaluate to a compile time integral value")
       end
       done = done and casenode.done and true
@@ -1976,6 +2008,10 @@ function visitors.Switch(context, node)
     done = done and elsenode.node and true
   end
   context:pop_scope()
+  if isstring and not node.attr.hashpositions then
+    -- choose the bytes hashed to dispatch the cases, ideally without collisions
+    node.attr.hashpositions = stringer.perfecthash_positions(casestrs)
+  end
   node.done = done
 end
 
@@ -2116,6 +2152,20 @@ function visitors.ForNum(context, node)
   attr.fixedend = fixedend
   attr.compop = compop
 
+  -- track the iterator range for loops counting up from a constant, used to remove bounds checks
+  if ittype and ittype.is_integral and battr.comptime and bn.isintegral(battr.value) and
+     not bn.isneg(battr.value) and stepvalue and bn.isintegral(stepvalue) and not bn.isneg(stepvalue) and
+     (compop == 'lt' or compop == 'le') then
+    local forrange = {minvalue=battr.value}
+    if eattr.comptime and bn.isintegral(eattr.value) then -- constant end
+      forrange.maxvalue = compop == 'lt' and eattr.value - 1 or eattr.value
+    elseif compop == 'lt' and endvalnode.is_Call and endvalnode[2].is_DotIndex and
+           endvalnode[2][1] == '__len' and endvalnode[1][1].is_Id then -- end is the length of a variable
+      forrange.lensymbol = endvalnode[1][1].attr
+    end
+    itvarnode.attr.forrange = forrange
+  end
+
   if ittype and btype and etype and (not stepvalnode or stype) then
     node.checked = true
   end
@@ -2244,6 +2294,54 @@ function visitors.Goto(context, node)
   node.done = true
 end
 
+function visitors.LabelAddr(context, node)
+  local labelname = node[1]
+  local label = context.scope:find_label(labelname)
+  local funcscope = context.scope:get_up_function_scope() or context.rootscope
+  if not label then
+    if not funcscope.resolved_once then
+      -- we should find it in the next traversal
+      funcscope:delay_resolution(true)
+      return
+    end
+    node:raisef("no visible label '%s' found for label address", labelname)
+  end
+  -- list the labels that computed gotos of the function may jump to
+  local addrlabels = funcscope.addrlabels
+  if not addrlabels then
+    addrlabels = {}
+    funcscope.addrlabels = addrlabels
+  end
+  if not addrlabels[label] then
+    addrlabels[#addrlabels+1] = label
+    addrlabels[label] = #addrlabels
+  end
+  label.used = true
+  local attr = node.attr
+  attr.label = label
+  attr.type = primtypes.pointer
+  node.done = true
+end
+
+function visitors.ComputedGoto(context, node)
+  local addrnode = node[1]
+  context:traverse_node(addrnode, {desiredtype=primtypes.pointer})
+  local addrtype = addrnode.attr.type
+  if addrtype and not addrtype.is_pointer then
+    addrnode:raisef("`goto` address must be a pointer, but got type '%s'", addrtype)
+  end
+  -- `goto` changes the control flow and cannot be used with defer statement
+  for scope in context.scope:iterate_up_scopes() do
+    if scope.has_defer then
+      node:raisef("cannot mix `goto` and `defer` statements")
+    end
+    if scope.is_function then
+      break
+    end
+  end
+  node.done = addrnode.done
+end
+
 local function visit_close(context, declnode, varnode, symbol)
   local objtype = varnode.attr.type
   if not objtype then return end
@@ -2438,6 +2536,9 @@ function visitors.Assign(context, node)
     local symbol = context:traverse_node(varnode)
     local vartype = varnode.attr.type
     local varattr = varnode.attr
+    if varnode.is_DotIndex and varnode[2].is_Id then -- assigning a field of a variable
+      varnode[2].attr.fieldmutate = true
+    end
     if varattr:is_readonly() and not varattr:is_forward_declare_type() then
       varnode:raisef("cannot assign a constant variable")
     end
@@ -2479,6 +2580,37 @@ function visitors.Assign(context, node)
   node.done = done
 end
 
+-- Checks whether a return in a `<musttail>` function can be emitted as a guaranteed tail call.
+local function check_tail_call(context, node, functype)
+  local callnode = #node == 1 and node[1]
+  if not (callnode and (callnode.is_Call or callnode.is_CallMethod)) then -- not a tail call
+    return
+  end
+  local calleetype = callnode.attr.calleetype
+  if not calleetype or not calleetype.is_procedure then -- not resolved yet
+    return
+  end
+  for scope in context.scope:iterate_up_scopes() do
+    if scope.has_defer then
+      node:raisef("cannot mix tail calls of `<musttail>` functions and `defer` statements")
+    end
+    if scope.is_function then
+      break
+    end
+  end
+  local argtypes, calleeargtypes = functype.argtypes, calleetype.argtypes
+  local same = #argtypes == #calleeargtypes and
+               #functype.rettypes == 1 and #calleetype.rettypes == 1 and
+               functype.rettypes[1] == calleetype.rettypes[1]
+  for i=1,#argtypes do
+    same = same and argtypes[i] == calleeargtypes[i]
+  end
+  if not same then
+    callnode:raisef("tail call in `<musttail>` function must have the same argument and return types \z
+      of the caller, but calling '%s' from '%s'", calleetype, functype)
+  end
+end
+
 function visitors.Return(context, node)
   local retnodes = node
   local funcscope = context.scope:get_up_function_scope() or context.rootscope
@@ -2533,6 +2665,10 @@ function visitors.Return(context, node)
       end
     end
   end
+  local funcsym = funcscope.funcsym
+  if funcsym and funcsym.musttail and funcsym.type then
+    check_tail_call(context, node, funcsym.type)
+  end
 end
 
 function visitors.In(context, node)
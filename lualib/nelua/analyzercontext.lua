@@ -24,6 +24,7 @@ function AnalyzerContext:_init(visitors, ast, generator)
   self.scope = self.rootscope
   self.usedbuiltins = {}
   self.requires = {}
+  self.dependencies = {}
   self.usedcodenames = {}
   self.afteranalyzes = {}
   self.afterinfers = {}
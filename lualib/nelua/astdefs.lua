@@ -341,6 +341,16 @@ aster.register('Goto', {
   name, -- label name
 })
 
+-- Computed goto statement, jumps to a label address (e.g `goto *addr`).
+aster.register('ComputedGoto', {
+  shaper.Node, -- label address expression
+})
+
+-- Label address expression (e.g `&&mylabel`).
+aster.register('LabelAddr', {
+  name, -- label name
+})
+
 -- Variable declaration statement.
 aster.register('VarDecl', {
   shaper.one_of{"local","global"}, -- scope
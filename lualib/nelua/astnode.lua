@@ -27,7 +27,7 @@ local ASTNode = class()
 ASTNode.baseshape = shaper.shape{
   -- Tag of the node.
   tag = shaper.string,
-  -- Unique identifier of the node.
+  -- Unique identifier of the node, assigned lazily by `ASTNode:get_uid()`.
   uid = shaper.number:is_optional(),
   -- Position in a source file where the text chunk of the node begins.
   pos = shaper.number:is_optional(),
@@ -84,11 +84,8 @@ Creates an AST node with metatable `mt` filled with values `...`.
 Called internally when creating or generating AST nodes.
 ]]
 function ASTNode._create(mt, ...)
-  local nuid = uid + 1
-  uid = nuid
   return setmetatable({
     attr = setmetatable({}, Attr),
-    uid = nuid,
     ...
   }, mt)
 end
@@ -104,15 +101,29 @@ getmetatable(ASTNode).__call = ASTNode._create
 --[[
 Creates an AST node with metatable `mt` from table `node`.
 Called for every AST node initialization while parsing.
+The parser preallocates room for exactly 4 fields in the node hash part,
+`pos`, `endpos`, `src` and `attr`, thus no more fields should be set here (optimization).
 ]]
 function ASTNode.create_from(mt, node)
-  local nuid = uid + 1
-  uid = nuid
-  node.uid = nuid
   node.attr = setmetatable({}, Attr)
   return setmetatable(node, mt)
 end
 
+--[[
+Returns the unique identifier for this node.
+Identifiers are assigned only for nodes that ask for one (e.g. to name a type),
+this keeps most nodes smaller.
+]]
+function ASTNode:get_uid()
+  local nuid = self.uid
+  if not nuid then
+    nuid = uid + 1
+    uid = nuid
+    self.uid = nuid
+  end
+  return nuid
+end
+
 -- Clones a list of nodes.
 function ASTNode.clone_nodes(t)
   local ct = {}
@@ -128,25 +139,28 @@ function ASTNode.clone_nodes(t)
 end
 clone_nodes = ASTNode.clone_nodes
 
--- Clones a node, copying only necessary values.
+--[[
+Clones a node, copying only necessary values.
+Optional fields are set only when present to keep the cloned node hash part small.
+]]
 function ASTNode.clone(node)
-  local nuid = uid + 1
-  uid = nuid
   local pattr = node.pattr
   local attr = setmetatable({}, Attr)
   local cloned = setmetatable({
     attr = attr,
-    pattr = pattr,
-    uid = nuid,
     pos = node.pos,
     endpos = node.endpos,
     src = node.src,
-    preprocess = node.preprocess,
     nil,nil,nil,nil,nil,nil -- preallocate array part (optimization)
   }, getmetatable(node))
   if pattr then -- copy persistent attributes
+    cloned.pattr = pattr
     tabler_update(attr, pattr)
   end
+  local preprocess = node.preprocess
+  if preprocess then
+    cloned.preprocess = preprocess
+  end
   for i=1,#node do
     local v = node[i]
     if type(v) == 'table' then
@@ -304,6 +318,8 @@ local ignored_stringfy_keys = {
   usedby = true,
   argattrs = true,
   defnode = true,
+  forrange = true,
+  fieldmutate = true,
 }
 
 -- Helper to convert a node value to a string.
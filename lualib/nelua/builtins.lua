@@ -76,6 +76,7 @@ function builtins.require(context, node, argnodes)
 
     attr.funcname = context.rootscope:generate_name('nelua_require_'..origunitname, true)
 
+    context:add_dependency(filepath)
     local input
     input, err = fs.readfile(filepath)
     if not input then
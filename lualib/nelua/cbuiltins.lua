@@ -139,6 +139,35 @@ function cbuiltins.NELUA_NORETURN(context)
 ]], 'directives')
 end
 
+-- Used by `<musttail>`.
+function cbuiltins.NELUA_MUSTTAIL(context)
+  context:define_builtin_macro('NELUA_MUSTTAIL', [[
+/* Macro used to guarantee a return call is a tail call. */
+#if defined(__has_attribute)
+  #if __has_attribute(musttail)
+    #define NELUA_MUSTTAIL __attribute__((musttail))
+  #endif
+#endif
+#ifndef NELUA_MUSTTAIL
+  #define NELUA_MUSTTAIL
+#endif
+]], 'directives')
+end
+
+-- Used by label addresses (e.g `&&mylabel`) and `goto *addr`.
+function cbuiltins.NELUA_LABEL_ADDR(context)
+  context:ensure_include('<stdint.h>')
+  context:define_builtin_macro('NELUA_LABEL_ADDR', [[
+/* Macro used to take the address of a label, computed gotos fallback to a switch without labels as values. */
+#if defined(__GNUC__) && !defined(NELUA_NO_COMPUTED_GOTO)
+  #define NELUA_COMPUTED_GOTO
+  #define NELUA_LABEL_ADDR(label, id) ((void*)&&label)
+#else
+  #define NELUA_LABEL_ADDR(label, id) ((void*)(uintptr_t)(id))
+#endif
+]], 'directives')
+end
+
 -- Used by `<atomic>`.
 function cbuiltins.NELUA_ATOMIC(context)
   context:define_builtin_macro('NELUA_ATOMIC', [[
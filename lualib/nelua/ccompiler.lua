@@ -417,7 +417,12 @@ function compiler.setup_env(cflags)
   end
 end
 
-function compiler.compile_binary(cfile, outfile, compileopts)
+--[[
+Prepare compilation of a C source file into a binary, without actually compiling it.
+Returns the binary file, whether it is an executable and the C compiler command to run,
+the command is nil when the binary is cached and there is nothing to compile.
+]]
+function compiler.prepare_binary(cfile, outfile, compileopts)
   local cflags = get_compiler_cflags(compileopts)
   compiler.setup_env(cflags)
   local ccinfo = compiler.get_cc_info()
@@ -429,8 +434,18 @@ function compiler.compile_binary(cfile, outfile, compileopts)
     local cfile_mtime = fs.getmodtime(cfile)
     local binfile_mtime = fs.getmodtime(binfile)
     local binfile_size = fs.getsize(binfile)
-    if cfile_mtime and binfile_mtime and cfile_mtime <= binfile_mtime and
-       binfile_size and binfile_size > 0 then
+    local cached = cfile_mtime and binfile_mtime and cfile_mtime <= binfile_mtime and
+                   binfile_size and binfile_size > 0
+    if cached and compileopts.incfiles then -- local headers may change without changing the C file
+      for _,incfile in ipairs(compileopts.incfiles) do
+        local incfile_mtime = fs.getmodtime(incfile)
+        if not incfile_mtime or incfile_mtime >= binfile_mtime then
+          cached = false
+          break
+        end
+      end
+    end
+    if cached then
       if config.verbose then console.info("using cached binary " .. binfile) end
       return binfile, isexe
     end
@@ -452,18 +467,33 @@ function compiler.compile_binary(cfile, outfile, compileopts)
   -- generate compile command
   local cccmd = get_compile_args(cfile, midfile, cflags)
   if config.verbose then console.info(cccmd) end
-  -- compile the file
-  if not executor.rexec(cccmd, nil, config.redirect_exec) then --luacov:disable
-    except.raisef("C compilation for '%s' failed", binfile)
-  end --luacov:enable
+  return binfile, isexe, cccmd
+end
+
+-- Finish a binary compiled from the command returned by `compiler.prepare_binary`.
+function compiler.finish_binary(binfile, isexe, compileopts)
+  local ccinfo = compiler.get_cc_info()
   -- compile static library
   if config.static_lib then
+    local midfile = binfile:gsub('.[a-z]+$', '.o')
     compiler.compile_static_lib(midfile, binfile)
     fs.deletefile(midfile)
   end
   if config.strip_bin and (config.shared_lib or isexe) and (not ccinfo.is_mirc or ccinfo.is_wasm) then
     compiler.strip_binary(binfile, compileopts)
   end
+end
+
+function compiler.compile_binary(cfile, outfile, compileopts)
+  local binfile, isexe, cccmd = compiler.prepare_binary(cfile, outfile, compileopts)
+  if not cccmd then -- cached
+    return binfile, isexe
+  end
+  -- compile the file
+  if not executor.rexec(cccmd, nil, config.redirect_exec) then --luacov:disable
+    except.raisef("C compilation for '%s' failed", binfile)
+  end --luacov:enable
+  compiler.finish_binary(binfile, isexe, compileopts)
   return binfile, isexe
 end
 
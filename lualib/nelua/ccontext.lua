@@ -50,6 +50,7 @@ function CContext:_init(visitors, typevisitors)
     linkdirs = {},
     cfiles = {},
     incdirs = {},
+    incfiles = {},
   }
   self.stringliterals = {}
   self.quotedliterals = {}
@@ -57,6 +58,8 @@ function CContext:_init(visitors, typevisitors)
   self.printcache = {}
   self.usedbuiltins = {}
   self.builtins = cbuiltins
+  self.removedboundschecks = 0
+  self.stackallocs = 0
 end
 
 function CContext:genuniquename(kind)
@@ -214,10 +217,17 @@ function CContext:ensure_include(name)
     if dirpath then
       local filepath = fs.join(dirpath, name)
       local incdirs = self.compileopts.incdirs
-      if fs.isfile(filepath) and not tabler.ifind(incdirs, dirpath) then
-        table.insert(incdirs, dirpath)
+      if fs.isfile(filepath) then
+        self:add_dependency(filepath)
+        table.insert(self.compileopts.incfiles, filepath)
+        if not tabler.ifind(incdirs, dirpath) then
+          table.insert(incdirs, dirpath)
+        end
       end
     end
+  elseif searchinc and fs.isfile(name) then
+    self:add_dependency(name)
+    table.insert(self.compileopts.incfiles, name)
   end
 end
 
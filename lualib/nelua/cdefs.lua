@@ -446,6 +446,23 @@ cdefs.target_info_code = [[
   is_s390x = true;
 #endif
 
+/* SIMD instruction sets */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  has_sse2 = true;
+#endif
+#if defined(__AVX__)
+  has_avx = true;
+#endif
+#if defined(__AVX2__)
+  has_avx2 = true;
+#endif
+#if defined(__AVX512F__)
+  has_avx512f = true;
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  has_neon = true;
+#endif
+
 /* C standard */
 #if defined(__STDC__)
   stdc = true;
@@ -544,6 +544,114 @@ function visitors.IdDecl(context, node, emitter)
   end
 end
 
+-- Maximum size in bytes of objects allocated by `new` that can be moved to the stack.
+local STACKALLOC_MAXSIZE = 1024
+
+-- Tags of nodes visited when searching uses of a variable.
+local ID_TAG = {Id = true}
+
+--[[
+Checks whether `argnode` in the arguments list `argnodes` of the call `callnode`
+may have its address implicitly taken, when passed to a pointer parameter.
+]]
+local function is_autoref_argument(callnode, argnodes, argnode)
+  if not (callnode and callnode.is_call) then return false end
+  local calleeargnodes = callnode.is_CallMethod and callnode[2] or callnode[1]
+  if calleeargnodes ~= argnodes then return false end
+  local argtype = argnode.attr.type
+  if not argtype or argtype.is_pointer then return false end
+  local calleetype = callnode.attr.calleetype
+  local argtypes = calleetype and calleetype.is_procedure and calleetype.argtypes
+  if not argtypes then return true end -- unknown callee, be conservative
+  local argindex = tabler.ifind(argnodes, argnode)
+  if callnode.is_CallMethod then -- skip the 'self' parameter
+    argindex = argindex + 1
+  end
+  local paramtype = argtypes[argindex]
+  return paramtype and paramtype.is_pointer or false
+end
+
+--[[
+Checks whether the address held by a pointer variable escapes in its use `idnode`,
+where `trace` is the list of parents of `idnode`.
+The pointer can only be dereferenced, directly or to access fields and elements of the pointed object,
+and only copies of values that are not addresses inside the pointed object can be taken from it.
+]]
+local function is_pointer_use_escaping(idnode, trace)
+  local child, isaddr = idnode, true -- whether `child` evaluates to an address inside the object
+  for i=#trace,1,-1 do
+    local parent = trace[i]
+    if (parent.is_DotIndex or parent.is_KeyIndex) and parent[2] == child or
+       (parent.is_UnaryOp and parent[1] == 'deref' and isaddr) then
+      isaddr = false -- storage inside the object
+    elseif parent.is_UnaryOp and parent[1] == 'ref' then
+      isaddr = true
+    elseif not isaddr and not parent._astnode and is_autoref_argument(trace[i-1], parent, child) then
+      return true -- the address of storage inside the object is implicitly taken by a call
+    else
+      -- addresses used in other contexts, methods that may take the object address
+      -- and arrays that may be converted to spans escape, anything else is a copy
+      return isaddr or (parent.is_CallMethod and parent[3] == child) or child.attr.type.is_array
+    end
+    child = parent
+  end
+  return isaddr
+end
+
+--[[
+Checks whether the value `valnode` of the local variable `varattr` is a `new` allocation
+from the garbage collector that never escapes the function, and thus can be allocated on the stack.
+The allocation must be made by a function with the `gcalloc` annotation,
+it must be small, its type cannot have `__new` or `__gc` metamethods,
+and the variable can only be used to access the pointed object.
+]]
+local function can_stack_allocate(context, varattr, valnode)
+  if not (valnode and valnode.is_call) or context.pragmas.nogc or varattr.staticstorage then
+    return false
+  end
+  local attr = valnode.attr
+  local calleesym = attr.calleesym
+  local argnodes = valnode.is_CallMethod and valnode[2] or valnode[1]
+  if not (calleesym and calleesym.gcalloc) or #argnodes ~= 1 or varattr.type ~= attr.type then
+    return false
+  end
+  local type = attr.type.is_pointer and attr.type.subtype
+  if not type or type.size == 0 or type.size > STACKALLOC_MAXSIZE or
+     (type.is_record and (type.metafields.__new or type.metafields.__gc)) then
+    return false
+  end
+  -- search all uses in the function, as 'repeat' conditions and 'defer' blocks can use the variable
+  -- (or in the file, for top scope variables of the main file and of required modules)
+  local nodestack = context.nodestack
+  local rootnode = nodestack[1]
+  for i=#nodestack,1,-1 do
+    local node = nodestack[i]
+    if node.is_function or node.attr.filename then
+      rootnode = node
+      break
+    end
+  end
+  for idnode, trace in rootnode:walk_trace_nodes(ID_TAG) do
+    if idnode.attr == varattr and is_pointer_use_escaping(idnode, trace) then
+      return false
+    end
+  end
+  context.stackallocs = context.stackallocs + 1
+  return true
+end
+
+-- Emits a `new` allocation that does not escape, as a C compound literal that lives in the current block.
+local function visitor_stackalloc(_, node, emitter, argnode)
+  local type = node.attr.type.subtype
+  emitter:add('(', type, '[1]){')
+  if argnode.attr.type.is_type then
+    emitter:add_zeroed_type_literal(type)
+  else
+    emitter:add_converted_val(type, argnode)
+  end
+  emitter:add('}')
+end
+
 local function visitor_Call(context, node, emitter, argnodes, callee, calleeobjnode)
   local isstatement = context:get_visiting_node(1).is_Block
   local attr = node.attr
@@ -683,7 +791,13 @@ end
 function visitors.Call(context, node, emitter, untyped)
   local argnodes, calleenode = node[1], node[2]
   local attr = node.attr
-  if attr.calleetype.is_type then -- is a type cast?
+  if attr.evalvalue ~= nil then -- call evaluated at compile time
+    if not context:get_visiting_node(1).is_Block then -- discard results of call statements
+      emitter:add_literal(attr, untyped)
+    end
+  elseif attr.stackalloc then -- 'new' allocation moved to the stack
+    visitor_stackalloc(context, node, emitter, argnodes[1])
+  elseif attr.calleetype.is_type then -- is a type cast?
     local argnode = argnodes[1]
     local argtype = argnode and argnode.attr.type
     local type = attr.type
@@ -711,6 +825,10 @@ end
 -- Emits a method call.
 function visitors.CallMethod(context, node, emitter)
   local name, argnodes, calleeobjnode = node[1], node[2], node[3]
+  if node.attr.stackalloc then -- 'new' allocation moved to the stack
+    visitor_stackalloc(context, node, emitter, argnodes[1])
+    return
+  end
   visitor_Call(context, node, emitter, argnodes, name, calleeobjnode)
 end
 
@@ -755,6 +873,31 @@ function visitors.ColonIndex(context, node, emitter)
   visitors.DotIndex(context, node, emitter)
 end
 
+--[[
+Checks whether the index `indexnode` is always in bounds,
+that is when it's a `for` iterator that is not mutated and its range is known
+to be inside an array of `length` elements, or inside the span variable `objnode`.
+In this case the bounds check can be removed.
+]]
+local function is_index_in_bounds(context, indexnode, length, objnode)
+  if context.pragmas.nochecks or not indexnode.is_Id then return false end
+  local itattr = indexnode.attr
+  local forrange = itattr.forrange
+  if not forrange or itattr.mutate or itattr.refed then return false end
+  local inbounds = false
+  if length then -- array
+    inbounds = length > 0 and forrange.maxvalue and forrange.maxvalue < length
+  elseif objnode.is_Id then -- span
+    local objattr = objnode.attr
+    inbounds = forrange.lensymbol == objattr and
+      not (objattr.mutate or objattr.refed or objattr.fieldmutate or objattr.staticstorage)
+  end
+  if inbounds then
+    context.removedboundschecks = context.removedboundschecks + 1
+  end
+  return inbounds
+end
+
 -- Emits key indexing.
 function visitors.KeyIndex(context, node, emitter)
   local indexnode, objnode = node[1], node[2]
@@ -790,7 +933,8 @@ function visitors.KeyIndex(context, node, emitter)
     else -- bounded array
       emitter:add(objnode, '.v[')
     end
-    if not context.pragmas.nochecks and objtype.length > 0 and not indexnode.attr.comptime then
+    if not context.pragmas.nochecks and objtype.length > 0 and not indexnode.attr.comptime and
+       not is_index_in_bounds(context, indexnode, objtype.length) then
       emitter:add_builtin('nelua_assert_bounds_', indexnode.attr.type)
       emitter:add('(', indexnode, ', ', objtype.length, ')]')
     else
@@ -859,7 +1003,11 @@ function visitors.Return(context, node, emitter)
       emitter:add_indent_ln('return ', retname, ';')
     else
       emitter:add_value(deferemitter)
-      emitter:add_indent('return ')
+      if functype and funcscope.funcsym.musttail and retnode and (retnode.is_Call or retnode.is_CallMethod) then
+        emitter:add_indent(context:ensure_builtin('NELUA_MUSTTAIL'), ' return ')
+      else
+        emitter:add_indent('return ')
+      end
       emitter:add_converted_val(rettype, retnode, nil, true)
       emitter:add_ln(';')
     end
@@ -958,17 +1106,93 @@ function visitors.If(_, node, emitter)
   emitter:add_indent_ln("}")
 end
 
+-- Emits the hash `hashname` of the string `valname`, as computed by `stringer.poshash`.
+local function emit_switch_string_hash(emitter, positions, valname, hashname)
+  emitter:add_indent_ln(primtypes.uint32, ' ', hashname, ' = (', primtypes.uint32, ')', valname, '.size;')
+  for _,pos in ipairs(positions) do
+    emitter:add_indent(hashname, ' = ', hashname, ' * 31 + ')
+    if pos >= 0 then
+      emitter:add_ln('(', valname, '.size > ', pos, ' ? ', valname, '.data[', pos, '] : 0);')
+    else
+      emitter:add_ln('(', valname, '.size >= ', -pos, ' ? ',
+                     valname, '.data[', valname, '.size - ', -pos, '] : 0);')
+    end
+  end
+end
+
+--[[
+Emits the dispatch of a `switch` on strings,
+returning the name of the variable set to the index of the matching case block.
+The hash has no collisions for most case sets, so a single comparison confirms the match.
+]]
+local function emit_switch_string_dispatch(context, node, emitter)
+  local valnode, casepairs = node[1], node[2]
+  local positions = node.attr.hashpositions
+  local funcscope = context.scope:get_up_function_scope()
+  local valname = funcscope:generate_name('_switchval')
+  local hashname = funcscope:generate_name('_switchhash')
+  local casename = funcscope:generate_name('_switchcase')
+  emitter:add_indent_ln(primtypes.string, ' ', valname, ' = ', valnode, ';')
+  emit_switch_string_hash(emitter, positions, valname, hashname)
+  emitter:add_indent_ln('int ', casename, ' = 0;')
+  -- group cases by hash
+  local hashcases = {}
+  local hashes = {}
+  for i=1,#casepairs,2 do
+    for _,casenode in ipairs(casepairs[i]) do
+      local s = casenode.attr.value
+      local h = stringer.poshash(s, positions)
+      local cases = hashcases[h]
+      if not cases then
+        cases = {}
+        hashcases[h] = cases
+        hashes[#hashes+1] = h
+      end
+      cases[#cases+1] = {s=s, index=(i+1)//2}
+    end
+  end
+  emitter:add_indent_ln('switch(', hashname, ') {') emitter:inc_indent()
+  for _,h in ipairs(hashes) do
+    emitter:add_indent_ln('case ', h, 'U:') emitter:inc_indent()
+    for _,case in ipairs(hashcases[h]) do
+      emitter:add_indent('if(', valname, '.size == ', #case.s)
+      if #case.s > 0 then
+        emitter:add(' && ')
+        emitter:add_builtin('memcmp')
+        emitter:add('(', valname, '.data, ')
+        emitter:add_string_literal(case.s, true)
+        emitter:add(', ', #case.s, ') == 0')
+      end
+      emitter:add_ln(') ', casename, ' = ', case.index, ';')
+    end
+    emitter:add_indent_ln('break;') emitter:dec_indent()
+  end
+  emitter:dec_indent() emitter:add_indent_ln('}')
+  return casename
+end
+
 -- Emits `switch` statement.
 function visitors.Switch(context, node, emitter)
   local valnode, casepairs, elsenode = node[1], node[2], node[3]
-  emitter:add_indent_ln("switch(", valnode, ") {") emitter:inc_indent()
+  local isstring = node.attr.hashpositions ~= nil
+  if isstring then
+    emitter:add_indent_ln('{') emitter:inc_indent()
+    local casename = emit_switch_string_dispatch(context, node, emitter)
+    emitter:add_indent_ln("switch(", casename, ") {") emitter:inc_indent()
+  else
+    emitter:add_indent_ln("switch(", valnode, ") {") emitter:inc_indent()
+  end
   context:push_forked_scope(node)
   for i=1,#casepairs,2 do -- add case blocks
     local caseexprs, caseblock = casepairs[i], casepairs[i+1]
-    for j=1,#caseexprs-1 do -- multiple cases
-      emitter:add_indent_ln("case ", caseexprs[j], ":")
+    if isstring then -- the case block index
+      emitter:add_indent_ln("case ", (i+1)//2, ': {')
+    else
+      for j=1,#caseexprs-1 do -- multiple cases
+        emitter:add_indent_ln("case ", caseexprs[j], ":")
+      end
+      emitter:add_indent_ln("case ", caseexprs[#caseexprs], ': {') -- last case
     end
-    emitter:add_indent_ln("case ", caseexprs[#caseexprs], ': {') -- last case
     emitter:add(caseblock) -- block
     local laststmt = caseblock[#caseblock]
     if not laststmt or not laststmt.is_breakflow then
@@ -987,6 +1211,9 @@ function visitors.Switch(context, node, emitter)
   end
   context:pop_scope(node)
   emitter:dec_indent() emitter:add_indent_ln("}")
+  if isstring then
+    emitter:dec_indent() emitter:add_indent_ln("}")
+  end
 end
 
 -- Emits `do` statement.
@@ -1197,6 +1424,36 @@ function visitors.Goto(context, node, emitter)
   emitter:add_indent_ln('goto ', context:declname(label), ';')
 end
 
+-- Emits computed `goto` statement.
+function visitors.ComputedGoto(context, node, emitter)
+  local addrnode = node[1]
+  local funcscope = context.scope:get_up_function_scope() or context.rootscope
+  local addrlabels = funcscope.addrlabels or {}
+  context:ensure_builtin('NELUA_LABEL_ADDR')
+  emitter:add_ln('#ifdef NELUA_COMPUTED_GOTO')
+  emitter:add_indent_ln('goto *', addrnode, ';')
+  emitter:add_ln('#else')
+  -- without labels as values the label addresses are indexes dispatched by a switch
+  emitter:add_indent_ln('switch((uintptr_t)(', addrnode, ')) {')
+  emitter:inc_indent()
+  for i,label in ipairs(addrlabels) do
+    emitter:add_indent_ln('case ', i, ': goto ', context:declname(label), ';')
+  end
+  -- jumping to an address that is not a label is undefined behavior, abort instead
+  emitter:add_indent_ln('default: ', context:ensure_builtin('nelua_abort'), '();')
+  emitter:dec_indent()
+  emitter:add_indent_ln('}')
+  emitter:add_ln('#endif')
+end
+
+-- Emits label address expression.
+function visitors.LabelAddr(context, node, emitter)
+  local label = node.attr.label
+  local funcscope = context.scope:get_up_function_scope() or context.rootscope
+  emitter:add_builtin('NELUA_LABEL_ADDR')
+  emitter:add('(', context:declname(label), ', ', funcscope.addrlabels[label], ')')
+end
+
 -- Emits variable declaration statement.
 function visitors.VarDecl(context, node, emitter)
   local varnodes, valnodes = node[2], node[3]
@@ -1206,6 +1463,9 @@ function visitors.VarDecl(context, node, emitter)
   for _,varnode,valnode,valtype,lastcallindex in izipargnodes(varnodes, valnodes or {}) do
     local varattr = varnode.attr
     local vartype = varattr.type
+    if not lastcallindex and can_stack_allocate(context, varattr, valnode) then
+      valnode.attr.stackalloc = true
+    end
     if lastcallindex == 1 then -- last assignment may be a multiple return call
       multiretvalname = upfuncscope:generate_name('_asgnret')
       local rettypename = context:funcrettypename(valnode.attr.calleetype)
@@ -1470,6 +1730,13 @@ function visitors.UnaryOp(context, node, emitter, untypedinit)
     return
   end
   local opname, argnode = node[1], node[2]
+  if opname == 'deref' and argnode.is_CallMethod and argnode[1] == '__atindex' then -- span indexing
+    local indexnode, objnode = argnode[2][1], argnode[3]
+    if objnode.attr.type.is_span and is_index_in_bounds(context, indexnode, nil, objnode) then
+      emitter:add(objnode, '.data[', indexnode, ']')
+      return
+    end
+  end
   local builtin = cbuiltins.operators[opname]
   builtin(context, node, emitter, argnode.attr, argnode)
 end
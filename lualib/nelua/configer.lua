@@ -33,6 +33,32 @@ local function convert_param(param)
   return param
 end
 
+-- Convert the garbage collector mode.
+local function convert_gc(param)
+  if param ~= 'incremental' and param ~= 'generational' and param ~= 'off' then
+    return nil, string.format("invalid garbage collector mode '%s'", param)
+  end
+  return param
+end
+
+-- Convert the maximum memory budget in megabytes.
+local function convert_max_memory(param)
+  local mb = tonumber(param)
+  if not mb or mb <= 0 then
+    return nil, string.format("invalid maximum memory '%s'", param)
+  end
+  return mb
+end
+
+-- Convert the number of parallel jobs.
+local function convert_jobs(param)
+  local jobs = math.tointeger(tonumber(param))
+  if not jobs or jobs < 1 then
+    return nil, string.format("invalid number of jobs '%s'", param)
+  end
+  return jobs
+end
+
 local function convert_add_path(param)
   if not fs.isdir(param) and not param:match('%?') then
     return nil, string.format("path '%s' is not a valid directory", param)
@@ -98,6 +124,10 @@ local function build_configs(conf)
     end
   end --luacov:enable
 
+  if conf.turbo then -- turbo disables the garbage collector
+    conf.gc = 'off'
+  end
+
   if conf.compile_only and conf.runner then
     conf.compile_only = nil
   end
@@ -203,6 +233,11 @@ local function create_parser()
   argparser:flag('--no-color', 'Disable colorized output in the terminal.', defconfig.no_color)
   argparser:option('-R --runner', "Execute compiled output with a runner", defconfig.runner)
   argparser:option('-o --output', 'Output file.', defconfig.output)
+  argparser:flag('--watch', "Watch the input and the files read while compiling it,\n\z
+                             compiling and running again in the same process when they change")
+  argparser:option('-j --jobs', "Compile many inputs running N C compilations in parallel\n\z
+                                 (all positional arguments are used as inputs)", defconfig.jobs)
+    :convert(convert_jobs)
   argparser:option('-D --define', 'Define values in the preprocessor')
     :count("*"):convert(convert_param)
   argparser:option('-P --pragma', 'Set initial compiler pragma')
@@ -216,6 +251,10 @@ local function create_parser()
   argparser:option('--stripflags', "Additional flags to pass when striping", defconfig.stripflags)
   argparser:option('--cache-dir', "Compilation cache directory", defconfig.cache_dir)
   argparser:option('--path', "Set module search path", defconfig.path)
+  argparser:option('--gc', "Compiler garbage collector mode (incremental/generational/off)", defconfig.gc)
+    :convert(convert_gc)
+  argparser:option('--max-memory', "Compiler memory budget in MB, collect garbage harder near it",
+    defconfig.max_memory):convert(convert_max_memory)
   -- the following are used only to debug/optimize the compiler
     argparser:flag('--profile-compiler', 'Print profiling for the compiler'):hidden(true)
     argparser:flag('--debug-resolve', "Print information about resolved types"):hidden(true)
@@ -225,7 +264,7 @@ local function create_parser()
     argparser:option('--lua-version', "Target lua version for lua generator", defconfig.lua_version):hidden(true)
     argparser:option('--lua-options', "Lua options to use when running", defconfig.lua_options):hidden(true)
     argparser:flag('-q --quiet', "Be quiet", defconfig.quiet):hidden(true)
-    argparser:flag('-j --turbo', "Compile faster by disabling the garbage collector (uses more MEM)"):hidden(true)
+    argparser:flag('--turbo', "Compile faster by disabling the garbage collector (uses more MEM)"):hidden(true)
   argparser:argument("runargs", "Arguments passed to the application\n\z
                                  Use '--' to avoid conflicts with compiler options")
     :args("*")
@@ -0,0 +1,643 @@
+--[[
+Evaluator module.
+
+The evaluator executes calls of functions marked with `<comptimeeval>` at compile time,
+when all call arguments are known at compile time.
+It interprets the already analyzed AST of the function body,
+performing operations with the same compile time semantics used by the analyzer
+to fold constant expressions, so the results match what the generated code would compute.
+
+Only a subset of the language is supported: scalars, booleans and arrays of them,
+local variables, control flow statements, type casts and calls to other functions.
+The evaluation gives up as soon as it finds anything that can only be done at runtime,
+like accessing pointers or global variables, calling C functions or raising errors,
+in that case the call is left to be done at runtime.
+]]
+
+local bn = require 'nelua.utils.bn'
+local Attr = require 'nelua.attr'
+
+local evaluator = {}
+
+-- Maximum number of evaluated nodes in a compile time call before giving up.
+evaluator.maxsteps = 100000
+-- Maximum depth of nested function calls in a compile time call before giving up.
+evaluator.maxdepth = 128
+
+-- Error object used to give up evaluating.
+local unsupported = setmetatable({}, {__tostring = function()
+  return 'unsupported compile time evaluation'
+end})
+
+-- Error object used to give up evaluating functions not fully analyzed yet, that may be evaluated later.
+local unresolved = setmetatable({}, {__tostring = function()
+  return 'unresolved compile time evaluation'
+end})
+
+-- Gives up the evaluation, leaving the call to be done at runtime.
+local function giveup()
+  error(unsupported, 0)
+end
+
+-- Metatable used to identify array values.
+local ArrayValue = {}
+
+-- Checks if a type can be evaluated.
+local function is_evaluable_type(type)
+  if type.is_scalar or type.is_boolean then
+    return true
+  elseif type.is_array then
+    return is_evaluable_type(type.subtype)
+  end
+  return false
+end
+
+-- Returns the zero value for a type.
+local function zero_value(type)
+  if type.is_integral then
+    return bn.zero()
+  elseif type.is_float then
+    return 0.0
+  elseif type.is_boolean then
+    return false
+  elseif type.is_array then
+    local subtype = type.subtype
+    local arr = setmetatable({}, ArrayValue)
+    for i=1,type.length do
+      arr[i] = zero_value(subtype)
+    end
+    return arr
+  end
+  giveup()
+end
+
+-- Rounds a float value to the precision of float type `type`, as done by the generated code.
+local function round_float(value, type)
+  if type.is_float32 then
+    return (string.unpack('f', string.pack('f', value)))
+  end
+  return value
+end
+
+-- Copies a value, arrays are copied by value.
+local function copy_value(value)
+  if getmetatable(value) == ArrayValue then
+    local arr = setmetatable({}, ArrayValue)
+    for i=1,#value do
+      arr[i] = copy_value(value[i])
+    end
+    return arr
+  end
+  return value
+end
+
+-- Converts a compile time value of an attr to an evaluated value.
+local function from_literal(value, type)
+  if type.is_array then
+    if type.is_comptime or not value then giveup() end
+    local arr = setmetatable({}, ArrayValue)
+    for i=1,type.length do
+      local elemattr = value[i]
+      arr[i] = elemattr and from_literal(elemattr.value, elemattr.type) or zero_value(type.subtype)
+    end
+    return arr
+  elseif not is_evaluable_type(type) or value == nil then
+    giveup()
+  elseif type.is_float then
+    return round_float(bn.tonumber(value) + 0.0, type)
+  end
+  return value
+end
+
+-- Converts an evaluated value to a compile time value of an attr.
+local function to_literal(value, type)
+  if type.is_array then
+    local list = {type=type}
+    local subtype = type.subtype
+    for i=1,#value do
+      list[i] = Attr{type=subtype, value=to_literal(value[i], subtype), comptime=true}
+    end
+    return list
+  end
+  return value
+end
+
+--[[
+Converts `value` of type `fromtype` to `totype`.
+Implicit conversions give up when the value does not fit, as those would be checked at runtime,
+while explicit conversions (type casts) truncate and wrap around.
+]]
+local function convert(value, fromtype, totype, explicit)
+  if fromtype == totype then
+    if totype.is_float then return round_float(value, totype) end
+    return copy_value(value)
+  elseif totype.is_integral and fromtype.is_scalar then
+    if fromtype.is_float then
+      if value ~= value or value == math.huge or value == -math.huge then giveup() end
+      if not explicit and math.floor(value) ~= value then giveup() end
+      value = bn.trunc(value)
+    end
+    if not totype:is_inrange(value) then
+      if not explicit then giveup() end
+      value = totype:wrap_value(value)
+    end
+    return value
+  elseif totype.is_float and fromtype.is_scalar then
+    return round_float(bn.tonumber(value) + 0.0, totype)
+  elseif totype.is_boolean and fromtype.is_boolean then
+    return value
+  elseif totype.is_array and fromtype.is_array and totype.length == fromtype.length then
+    local arr = setmetatable({}, ArrayValue)
+    for i=1,#value do
+      arr[i] = convert(value[i], fromtype.subtype, totype.subtype, explicit)
+    end
+    return arr
+  end
+  giveup()
+end
+
+-- Returns the truthiness of a value.
+local function is_truthy(value, type)
+  if type.is_boolean then
+    return value
+  elseif type.is_scalar then
+    return true
+  end
+  giveup()
+end
+
+local eval_expr, exec_block, call_function
+
+-- Counts an evaluation step, giving up when too many steps were taken.
+local function step(ev)
+  local steps = ev.steps + 1
+  if steps > evaluator.maxsteps then giveup() end
+  ev.steps = steps
+end
+
+-- Returns the array value referenced by node `node`, without copying it.
+local function eval_ref(ev, frame, node)
+  if node.is_Id then
+    local value = frame.vars[node.attr]
+    if value == nil then giveup() end
+    return value
+  elseif node.is_KeyIndex then
+    local objnode, indexnode = node[2], node[1]
+    local objtype = objnode.attr.type
+    if not objtype or not objtype.is_array then giveup() end
+    local arr = eval_ref(ev, frame, objnode)
+    local index = bn.compress(eval_expr(ev, frame, indexnode))
+    if math.type(index) ~= 'integer' or index < 0 or index >= #arr then giveup() end
+    return arr, index + 1
+  end
+  giveup()
+end
+
+local exprs = {}
+
+function exprs.Paren(ev, frame, node)
+  return eval_expr(ev, frame, node[1])
+end
+
+function exprs.Id(_, frame, node)
+  local value = frame.vars[node.attr]
+  if value == nil then giveup() end
+  return value
+end
+
+function exprs.KeyIndex(ev, frame, node)
+  local arr, index = eval_ref(ev, frame, node)
+  return arr[index]
+end
+
+function exprs.InitList(ev, frame, node)
+  local type = node.attr.type
+  if not type or not type.is_array or #node > type.length then giveup() end
+  local subtype = type.subtype
+  local arr = setmetatable({}, ArrayValue)
+  for i=1,type.length do
+    local childnode = node[i]
+    if childnode then
+      if childnode.is_Pair then giveup() end
+      arr[i] = convert(eval_expr(ev, frame, childnode), childnode.attr.type, subtype)
+    else
+      arr[i] = zero_value(subtype)
+    end
+  end
+  return arr
+end
+
+function exprs.UnaryOp(ev, frame, node)
+  local opname, argnode = node[1], node[2]
+  local argtype = argnode.attr.type
+  if opname == 'ref' or opname == 'deref' or not argtype or
+     not (argtype.is_scalar or argtype.is_boolean) then
+    giveup()
+  end
+  local argattr = Attr{type=argtype, value=eval_expr(ev, frame, argnode), comptime=true}
+  local type, value, err = argtype:unary_operator(opname, argattr)
+  if err or value == nil then giveup() end
+  return convert(value, type, node.attr.type, true)
+end
+
+function exprs.BinaryOp(ev, frame, node)
+  local lnode, opname, rnode = node[1], node[2], node[3]
+  local attr = node.attr
+  local type, ltype, rtype = attr.type, lnode.attr.type, rnode.attr.type
+  if attr.ternaryor then -- `cond and a or b`
+    local condnode, anode = lnode[1], lnode[3]
+    if is_truthy(eval_expr(ev, frame, condnode), condnode.attr.type) then
+      local aval = eval_expr(ev, frame, anode)
+      if is_truthy(aval, anode.attr.type) then
+        return convert(aval, anode.attr.type, type)
+      end
+    end
+    return convert(eval_expr(ev, frame, rnode), rtype, type)
+  elseif opname == 'and' or opname == 'or' then
+    if not (type.is_boolean and ltype.is_boolean and rtype.is_boolean) then giveup() end
+    local lval = eval_expr(ev, frame, lnode)
+    if (opname == 'and') == lval then -- must evaluate the right side
+      return eval_expr(ev, frame, rnode)
+    end
+    return lval
+  end
+  if not ltype or not rtype or not (ltype.is_scalar or ltype.is_boolean) or
+     not (rtype.is_scalar or rtype.is_boolean) then
+    giveup()
+  end
+  local lattr = Attr{type=ltype, value=eval_expr(ev, frame, lnode), comptime=true,
+                     untyped=lnode.attr.comptime and lnode.attr.untyped}
+  local rattr = Attr{type=rtype, value=eval_expr(ev, frame, rnode), comptime=true,
+                     untyped=rnode.attr.comptime and rnode.attr.untyped}
+  local retype, value, err = ltype:binary_operator(opname, rtype, lattr, rattr)
+  if err or value == nil then giveup() end
+  return convert(value, retype, type, true)
+end
+
+function exprs.Call(ev, frame, node)
+  local attr = node.attr
+  local calleetype, argnodes = attr.calleetype, node[1]
+  if not calleetype then giveup() end
+  if calleetype.is_type then -- type cast
+    if #argnodes == 0 then
+      return zero_value(attr.type)
+    elseif #argnodes > 1 then
+      giveup()
+    end
+    local argnode = argnodes[1]
+    return convert(eval_expr(ev, frame, argnode), argnode.attr.type, attr.type, true)
+  end
+  local calleesym = attr.calleesym
+  if not calleesym or attr.ismethod or attr.ismetacall then giveup() end
+  local args, argtypes = {}, {}
+  for i=1,#argnodes do
+    local argnode = argnodes[i]
+    if argnode.is_Varargs or not argnode.attr.type then giveup() end
+    args[i] = eval_expr(ev, frame, argnode)
+    argtypes[i] = argnode.attr.type
+  end
+  return call_function(ev, calleesym, args, argtypes)
+end
+
+-- Evaluates expression `node`, returning its value.
+function eval_expr(ev, frame, node)
+  step(ev)
+  local attr = node.attr
+  local type = attr.type
+  if not type then giveup() end
+  if attr.comptime then
+    return from_literal(attr.value, type)
+  end
+  local visit = exprs[node.tag]
+  if not visit or not is_evaluable_type(type) then giveup() end
+  return visit(ev, frame, node)
+end
+
+local stats = {}
+
+function stats.Return(ev, frame, node)
+  if #node ~= 1 then giveup() end
+  local retnode = node[1]
+  frame.retval = convert(eval_expr(ev, frame, retnode), retnode.attr.type, frame.rettype)
+  return 'return'
+end
+
+function stats.VarDecl(ev, frame, node)
+  local varnodes, valnodes = node[2], node[3]
+  if node[1] ~= 'local' or (valnodes and #valnodes ~= #varnodes) then giveup() end
+  local vars = frame.vars
+  for i=1,#varnodes do
+    local varattr = varnodes[i].attr
+    local vartype = varattr.type
+    if not varattr.comptime then
+      if not vartype or not is_evaluable_type(vartype) then giveup() end
+      local valnode = valnodes and valnodes[i]
+      if valnode then
+        vars[varattr] = convert(eval_expr(ev, frame, valnode), valnode.attr.type, vartype)
+      else
+        vars[varattr] = zero_value(vartype)
+      end
+    end
+  end
+end
+
+function stats.Assign(ev, frame, node)
+  local varnodes, valnodes = node[1], node[2]
+  if #valnodes ~= #varnodes then giveup() end
+  -- evaluate all values before assigning
+  local values = {}
+  for i=1,#varnodes do
+    local vartype, valnode = varnodes[i].attr.type, valnodes[i]
+    if not vartype then giveup() end
+    values[i] = convert(eval_expr(ev, frame, valnode), valnode.attr.type, vartype)
+  end
+  for i=1,#varnodes do
+    local varnode = varnodes[i]
+    if varnode.is_Id then
+      local vars = frame.vars
+      if vars[varnode.attr] == nil then giveup() end
+      vars[varnode.attr] = values[i]
+    else
+      local arr, index = eval_ref(ev, frame, varnode)
+      if not index then giveup() end
+      arr[index] = values[i]
+    end
+  end
+end
+
+function stats.Call(ev, frame, node)
+  exprs.Call(ev, frame, node)
+end
+
+function stats.Do(ev, frame, node)
+  return exec_block(ev, frame, node[1])
+end
+
+function stats.If(ev, frame, node)
+  local ifparts, elseblock = node[1], node[2]
+  for i=1,#ifparts,2 do
+    local condnode, blocknode = ifparts[i], ifparts[i+1]
+    if is_truthy(eval_expr(ev, frame, condnode), condnode.attr.type) then
+      return exec_block(ev, frame, blocknode)
+    end
+  end
+  if elseblock then
+    return exec_block(ev, frame, elseblock)
+  end
+end
+
+function stats.Switch(ev, frame, node)
+  local valnode, caseparts, elseblock = node[1], node[2], node[3]
+  local valtype = valnode.attr.type
+  if not valtype or not valtype.is_scalar then giveup() end
+  local valattr = Attr{type=valtype, value=eval_expr(ev, frame, valnode), comptime=true}
+  for i=1,#caseparts,2 do
+    local caseexprs, blocknode = caseparts[i], caseparts[i+1]
+    for j=1,#caseexprs do
+      local casenode = caseexprs[j]
+      local caseattr = Attr{type=casenode.attr.type, value=eval_expr(ev, frame, casenode), comptime=true}
+      local _, eq, err = valtype:binary_operator('eq', caseattr.type, valattr, caseattr)
+      if err or eq == nil then giveup() end
+      if eq then
+        return exec_block(ev, frame, blocknode)
+      end
+    end
+  end
+  if elseblock then
+    return exec_block(ev, frame, elseblock)
+  end
+end
+
+function stats.Break()
+  return 'break'
+end
+
+function stats.Continue()
+  return 'continue'
+end
+
+function stats.While(ev, frame, node)
+  local condnode, blocknode = node[1], node[2]
+  while is_truthy(eval_expr(ev, frame, condnode), condnode.attr.type) do
+    local ctl = exec_block(ev, frame, blocknode)
+    if ctl == 'break' then break
+    elseif ctl == 'return' then return ctl
+    end
+  end
+end
+
+function stats.Repeat(ev, frame, node)
+  local blocknode, condnode = node[1], node[2]
+  repeat
+    local ctl = exec_block(ev, frame, blocknode)
+    if ctl == 'break' then break
+    elseif ctl == 'return' then return ctl
+    end
+  until is_truthy(eval_expr(ev, frame, condnode), condnode.attr.type)
+end
+
+function stats.ForNum(ev, frame, node)
+  local itnode, begvalnode, compop, endvalnode, stepvalnode, blocknode = table.unpack(node, 1, 6)
+  local itattr = itnode.attr
+  local ittype = itattr.type
+  if not ittype or not ittype.is_scalar then giveup() end
+  local it = convert(eval_expr(ev, frame, begvalnode), begvalnode.attr.type, ittype)
+  local endval = convert(eval_expr(ev, frame, endvalnode), endvalnode.attr.type, ittype)
+  local stepval = ittype.is_float and 1.0 or bn.one()
+  if stepvalnode then
+    stepval = convert(eval_expr(ev, frame, stepvalnode), stepvalnode.attr.type, ittype)
+  end
+  if not compop then -- same as the runtime detection of the compare operation
+    local negstep
+    if ittype.is_float then
+      negstep = stepval < 0
+    else
+      negstep = bn.isneg(stepval)
+    end
+    compop = negstep and 'ge' or 'le'
+  end
+  local endattr = Attr{type=ittype, value=endval, comptime=true}
+  local stepattr = Attr{type=ittype, value=stepval, comptime=true}
+  local vars = frame.vars
+  while true do
+    local itvalattr = Attr{type=ittype, value=it, comptime=true}
+    local _, cond, err = ittype:binary_operator(compop, ittype, itvalattr, endattr)
+    if err or cond == nil then giveup() end
+    if not cond then break end
+    vars[itattr] = it
+    local ctl = exec_block(ev, frame, blocknode)
+    if ctl == 'break' then break
+    elseif ctl == 'return' then return ctl
+    end
+    local retype, nextit
+    retype, nextit, err = ittype:binary_operator('add', ittype, itvalattr, stepattr)
+    if err or nextit == nil then giveup() end
+    it = convert(nextit, retype, ittype, true)
+  end
+end
+
+-- Executes statements of block `node`, returning 'break', 'continue' or 'return' on control flow changes.
+function exec_block(ev, frame, node)
+  for i=1,#node do
+    local statnode = node[i]
+    step(ev)
+    local exec = stats[statnode.tag]
+    if not exec then giveup() end
+    local ctl = exec(ev, frame, statnode)
+    if ctl then
+      return ctl
+    end
+  end
+end
+
+-- Results of `is_evaluable_body` for functions with all expressions typed.
+local evaluable_funcs = setmetatable({}, {__mode='k'})
+
+--[[
+Checks whether the body of the function definition `defnode` may be evaluated,
+so evaluations using pointers or variables declared outside the function (like global variables)
+give up before interpreting anything.
+Returns nil when the body has expressions not typed yet.
+]]
+local function is_evaluable_body(defnode)
+  local argnodes, blocknode = defnode[3], defnode[6]
+  local localvars = {}
+  for i=1,#argnodes do
+    localvars[argnodes[i].attr] = true
+  end
+  for node in blocknode:walk_nodes() do
+    if node.is_IdDecl then
+      localvars[node.attr] = true
+    end
+  end
+  for node in blocknode:walk_nodes() do
+    local attr = node.attr
+    local type = attr.type
+    if not type and (exprs[node.tag] or node.is_IdDecl) then
+      return nil
+    elseif node.is_UnaryOp and (node[1] == 'ref' or node[1] == 'deref') then
+      return false
+    elseif not attr.comptime and type and type.is_pointer then
+      return false
+    elseif node.is_Id and not localvars[attr] and not attr.comptime and
+           not (type and (type.is_function or type.is_type)) then
+      return false
+    end
+  end
+  return true
+end
+
+-- Calls function `funcsym` with evaluated arguments `args` of types `argtypes`, returning its result.
+function call_function(ev, funcsym, args, argtypes)
+  local functype, defnode = funcsym.type, funcsym.defnode
+  if not functype then error(unresolved, 0) end
+  if not functype.is_function or not defnode or not defnode.is_FuncDef or
+     defnode.attr ~= funcsym or funcsym.cimport or funcsym.nodecl or funcsym.hookmain or
+     #functype.rettypes ~= 1 or not is_evaluable_type(functype.rettypes[1]) then
+    giveup()
+  end
+  local varnode, argnodes, blocknode = defnode[2], defnode[3], defnode[6]
+  if varnode.is_ColonIndex or #argnodes ~= #args or ev.depth >= evaluator.maxdepth then giveup() end
+  local evaluable = evaluable_funcs[funcsym]
+  if evaluable == nil then
+    evaluable = is_evaluable_body(defnode)
+    if evaluable == nil then error(unresolved, 0) end
+    evaluable_funcs[funcsym] = evaluable
+  end
+  if not evaluable then giveup() end
+  local vars = {}
+  for i=1,#argnodes do
+    local argattr = argnodes[i].attr
+    local argtype = argattr.type
+    if not argtype or not is_evaluable_type(argtype) or argattr.comptime then giveup() end
+    vars[argattr] = convert(args[i], argtypes[i], argtype)
+  end
+  local frame = {vars=vars, rettype=functype.rettypes[1]}
+  ev.depth = ev.depth + 1
+  if exec_block(ev, frame, blocknode) ~= 'return' then giveup() end
+  ev.depth = ev.depth - 1
+  return frame.retval
+end
+
+-- Results of evaluated calls by function and arguments key.
+local call_results = setmetatable({}, {__mode='k'})
+-- Value stored in `call_results` for calls given up.
+local givenup = {}
+
+-- Returns a key identifying scalar arguments `args` of types `argtypes`, or nil for other arguments.
+local function make_call_key(args, argtypes)
+  local parts = {}
+  for i=1,#args do
+    local value, argtype = args[i], argtypes[i]
+    if argtype.is_float then
+      parts[i] = string.format('%s:%a', argtype, value)
+    elseif argtype.is_integral or argtype.is_boolean then
+      parts[i] = string.format('%s:%s', argtype, value)
+    else
+      return nil
+    end
+  end
+  return table.concat(parts, ',')
+end
+
+--[[
+Evaluates the call of function `funcsym` with argument nodes `argnodes` at compile time.
+All arguments must be known at compile time.
+Returns the compile time value of the call result on success, otherwise nil
+followed by whether the call would give up again when retried later.
+Results are reused by calls with the same scalar arguments, so calls that give up are not evaluated again.
+]]
+function evaluator.eval_call(funcsym, argnodes)
+  local functype = funcsym.type
+  if not functype or #functype.rettypes ~= 1 then return nil, functype ~= nil end
+  local args, argtypes = {}, {}
+  for i=1,#argnodes do
+    local argattr = argnodes[i].attr
+    local argtype = argattr.type
+    if not argattr.comptime or not argtype then return nil, false end
+    args[i] = argattr.value
+    argtypes[i] = argtype
+  end
+  local key = make_call_key(args, argtypes)
+  local results = call_results[funcsym]
+  if key and results then
+    local value = results[key]
+    if value == givenup then
+      return nil, true
+    elseif value ~= nil then
+      return value
+    end
+  end
+  local ok, value = pcall(function()
+    local evargs = {}
+    for i=1,#args do
+      evargs[i] = from_literal(args[i], argtypes[i])
+    end
+    local ev = {steps=0, depth=0}
+    return call_function(ev, funcsym, evargs, argtypes)
+  end)
+  if not ok then
+    if value == unresolved then
+      return nil, false
+    elseif value ~= unsupported then
+      error(value, 0)
+    end
+    value = givenup
+  else
+    value = to_literal(value, functype.rettypes[1])
+  end
+  -- array literals are mutable lists, thus not shared
+  if key and (value == givenup or not functype.rettypes[1].is_array) then
+    if not results then
+      results = {}
+      call_results[funcsym] = results
+    end
+    results[key] = value
+  end
+  if value == givenup then
+    return nil, true
+  end
+  return value
+end
+
+return evaluator
@@ -37,6 +37,13 @@ function lua_compiler.compile_code(luacode, luafile)
   if config.verbose then console.info("generated " .. luafile) end
 end
 
+function lua_compiler.prepare_binary(luafile)
+  return luafile, true
+end
+
+function lua_compiler.finish_binary()
+end
+
 function lua_compiler.compile_binary(luafile)
   return luafile, true
 end
@@ -263,6 +263,14 @@ function visitors.Goto(_, node, emitter)
   emitter:add_indent_ln('goto ', labelname)
 end
 
+function visitors.ComputedGoto(_, node)
+  node:raisef('computed goto is not supported in lua')
+end
+
+function visitors.LabelAddr(_, node)
+  node:raisef('label addresses are not supported in lua')
+end
+
 function visitors.VarDecl(context, node, emitter)
   local varscope, varnodes, valnodes = node[1], node[2], node[3]
   local is_local = (varscope == 'local') or not context.scope.is_topscope
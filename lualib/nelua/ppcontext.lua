@@ -21,6 +21,9 @@ local typedefs = require 'nelua.typedefs'
 -- The preprocess context class.
 local PPContext = class()
 
+-- Script paths of the modules loaded by `PPContext:require`, by module name.
+local loadedpaths = {}
+
 -- Used to quickly check whether a table is an analyzer context.
 PPContext._ppcontext = true
 
@@ -475,11 +478,19 @@ function PPContext:require(reqname)
     modname = reqpath
   end
   local mod = package.loaded[modname] -- lookup for a loaded module
-  if mod then return mod end -- module already loaded? return it
+  if mod then -- module already loaded? return it
+    if loadedpaths[modname] then
+      self.context:add_dependency(loadedpaths[modname], modname)
+    end
+    return mod
+  end
   local loader, loaderdata
   local loaderrs = {}
   local found = false
   if reqpath then
+    if fs.isfile(reqpath) then -- watch it even when it fails to load
+      self.context:add_dependency(reqpath, modname)
+    end
     local contents, err = fs.readfile(reqpath)
     if contents then
       loader, err = load(contents, '@'..reqpath)
@@ -507,6 +518,10 @@ function PPContext:require(reqname)
   end
   -- check if module was already loaded by full path
   local modpath = type(loaderdata) == 'string' and fs.abspath(loaderdata)
+  if modpath and fs.isfile(modpath) then
+    loadedpaths[modname] = modpath
+    self.context:add_dependency(modpath, modname)
+  end
   mod = package.loaded[modpath]
   if mod then -- already loaded under a different name
     package.loaded[modname] = mod
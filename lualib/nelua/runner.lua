@@ -10,17 +10,17 @@ if _VERSION ~= 'Lua 5.4' and _VERSION ~= 'Lua 5.3' then
   error 'Please use Lua 5.4'
 end
 
--- Make the lua garbage collector less aggressive to speed up compilation.
-if _VERSION == 'Lua 5.4' then
-  collectgarbage("incremental", 800, 400, 16)
-end
-
 -- Timers must be the first loaded module.
 local nanotimer = require 'nelua.utils.nanotimer'
 local globaltimer = nanotimer.globaltimer
 local timer = nanotimer()
 
+-- Make the lua garbage collector less aggressive to speed up compilation.
+local memtracker = require 'nelua.utils.memtracker'
+memtracker.setup_gc()
+
 local tracker = require 'nelua.utils.tracker'
+local tabler = require 'nelua.utils.tabler'
 local stringer = require 'nelua.utils.stringer'
 local console = require 'nelua.utils.console'
 local fs = require 'nelua.utils.fs'
@@ -32,6 +32,9 @@ local version = require 'nelua.version'
 local config = configer.get()
 local profiler
 
+-- Files read while compiling the inputs of the last run, watched in watch mode.
+local dependencies = {}
+
 local runner = {}
 
 -- Show compiler version.
@@ -114,56 +117,31 @@ function runner.stop_profiling()
   profiler.report{self=true, min_usage=0.1}
 end
 
-local function run(args, redirect)
-  load_nelua_init()
-  local options = configer.parse(args) -- parse options
-  -- set lua path and restore it when run ends
-  local oldluapath = package.path
-  package.path = options.lua_path
-  local _ <close> = setmetatable({}, {__close = function()
-    package.path = oldluapath
-  end})
-  -- handle actions that exits early
-  if config.version then
-    return runner.show_version()
-  elseif config.semver then
-    return runner.show_semver()
-  elseif config.config then
-    return runner.show_config(options)
-  elseif config.script then
-    return runner.run_script()
+-- Read an input source, returning its contents and name.
+local function read_input(inputname)
+  if config.eval then -- source from input argument
+    return inputname, 'eval_'..stringer.hash(inputname, 8)
+  elseif inputname == '-' then -- source from stdin
+    --luacov:disable
+    return io.read('*a'), 'stdin_'..stringer.hash(inputname, 8)
+  end --luacov:enable
+  local input, err = fs.readfile(inputname)
+  if not input then
+    except.raisef("Failed to read input file: %s", err)
   end
-  -- this is required here because the config may affect how they load
-  local generator = require('nelua.'..config.generator..'generator')
+  return input, inputname
+end
+
+--[[
+Parse, analyze and generate the backend source file for an input.
+Returns the generated source file, the output file prefix and the analyzer context,
+or nil when there is nothing more to do for the input.
+]]
+local function generate_input(input, inputname, generator)
   local preprocessor = require 'nelua.preprocessor'
   local analyzer = require 'nelua.analyzer'
   local AnalyzerContext = require 'nelua.analyzercontext'
   local compiler = generator.compiler
-  if config.timing then
-    console.debugf('startup      %.1f ms', timer:elapsedrestart())
-  end
-  -- determine input
-  local input, inputname
-  if config.eval then -- source from input argument
-    inputname = 'eval_'..stringer.hash(config.input, 8)
-    input = config.input
-  elseif config.input == '-' then -- source from stdin
-    --luacov:disable
-    inputname = 'stdin_'..stringer.hash(config.input, 8)
-    input = io.read('*a')
-  else --luacov:enable
-    inputname = config.input
-    if not inputname then
-      console.error('Missing input, please pass a source file as an argument.')
-      return 1
-    end
-    local err
-    input, err = fs.readfile(inputname)
-    if not input then
-      console.errorf("Failed to read input file: %s", err)
-      return 1
-    end
-  end
   -- execute arbitrary code from config before parsing
   if config.before_parse then
     config.before_parse()
@@ -174,15 +152,19 @@ local function run(args, redirect)
   local ast = aster.parse(input, inputname)
   -- only checking syntax?
   if config.lint then
-    return 0
+    return
   end
   -- only printing ast?
   if config.print_ast then
     console.info(tostring(ast))
-    return 0
+    return
   end
   -- analyze the ast
   local context = AnalyzerContext(analyzer.visitors, ast, config.generator)
+  context.dependencies = dependencies
+  if fs.isfile(inputname) then
+    context:add_dependency(inputname)
+  end
   except.try(function()
     context = analyzer.analyze(context)
   end, function(e)
@@ -193,24 +175,31 @@ local function run(args, redirect)
     local elapsed = timer:elapsedrestart()
     console.debugf('parse        %.1f ms', aster.parsing_time)
     console.debugf('preprocess   %.1f ms', preprocessor.working_time)
-    console.debugf('analyze      %.1f ms', elapsed - aster.parsing_time - preprocessor.working_time)
+    console.debugf('analyze      %.1f ms%s', elapsed - aster.parsing_time - preprocessor.working_time,
+      memtracker.format_phase())
   end
   -- only analyzing ast?
   if config.analyze or config.print_analyzed_ast or config.print_ppcode then
     if config.print_analyzed_ast then
       console.info(tostring(ast))
     end
-    return 0
+    return
   end
   -- generate the code
   local code = generator.generate(context)
   if config.timing then
-    console.debugf('generate     %.1f ms', timer:elapsedrestart())
+    console.debugf('generate     %.1f ms%s', timer:elapsedrestart(), memtracker.format_phase())
+  end
+  if config.more_timing and context.removedboundschecks then
+    console.debugf('removed %d bounds checks', context.removedboundschecks)
+  end
+  if config.more_timing and context.stackallocs then
+    console.debugf('moved %d allocations to the stack', context.stackallocs)
   end
   -- only printing generated code?
   if config.print_code then
     console.info(code)
-    return 0
+    return
   end
   -- choose a name for generated files
   local barename
@@ -229,6 +218,149 @@ local function run(args, redirect)
   compiler.compile_code(code, sourcefile, context.compileopts)
   -- only compiling code?
   if config.code then
+    return
+  end
+  return sourcefile, outprefix, context
+end
+
+-- Execute a compiled binary.
+local function run_binary(compiler, outfile, runargs, compileopts, redirect)
+  local exe, exeargs = compiler.get_run_command(outfile, runargs, compileopts)
+  if config.verbose then console.info(exe .. ' ' .. table.concat(exeargs, ' ')) end
+  local _, status = executor.rexec(exe, exeargs, redirect)
+  if config.timing then
+    console.debugf('run          %.1f ms', timer:elapsedrestart())
+  end
+  return status
+end
+
+--[[
+Compile many inputs in the same compiler process.
+Inputs are analyzed and generated sequentially,
+while their C compilations run concurrently in a process pool of `config.jobs` processes.
+]]
+local function run_many(inputnames, generator, redirect)
+  local compiler = generator.compiler
+  local pool = executor.ProcessPool(config.jobs)
+  local builds = {}
+  for i,inputname in ipairs(inputnames) do
+    local build = {inputname = inputname}
+    builds[i] = build
+    except.try(function()
+      local input
+      input, inputname = read_input(inputname)
+      local sourcefile, outprefix, context = generate_input(input, inputname, generator)
+      if not sourcefile then return end
+      local binfile, isexe, cccmd = compiler.prepare_binary(sourcefile, outprefix, context.compileopts)
+      build.binfile, build.isexe, build.compileopts = binfile, isexe, context.compileopts
+      build.compiled = cccmd ~= nil -- cached binaries are already finished
+      if cccmd then
+        pool:spawn(cccmd, nil, function(ok, status, output)
+          build.output = output
+          if not ok or status ~= 0 then
+            build.errmsg = string.format("C compilation for '%s' failed", binfile)
+          end
+        end)
+      end
+    end, function(e)
+      build.errmsg = e:get_message()
+      return true
+    end)
+  end
+  pool:waitall()
+  if config.timing then
+    console.debugf('compile      %.1f ms', timer:elapsedrestart())
+  end
+  -- finish the builds and report their results in order
+  local numfailed = 0
+  local status = 0
+  for _,build in ipairs(builds) do
+    if build.output and #build.output > 0 then
+      io.stderr:write(build.output)
+      io.stderr:flush()
+    end
+    if build.compiled and not build.errmsg then
+      except.try(function()
+        compiler.finish_binary(build.binfile, build.isexe, build.compileopts)
+      end, function(e)
+        build.errmsg = e:get_message()
+        return true
+      end)
+    end
+    if build.errmsg then
+      numfailed = numfailed + 1
+      if not build.errmsg:find('error: ') then
+        console.error(build.errmsg)
+      else
+        console.logerr(build.errmsg)
+      end
+    elseif build.binfile then
+      if config.verbose then console.info("compiled " .. build.binfile) end
+      if build.isexe and not config.compile_only then
+        local runstatus = run_binary(compiler, build.binfile, {}, build.compileopts, redirect)
+        if runstatus ~= 0 then
+          console.errorf("%s: exited with status %d", build.inputname, runstatus)
+          numfailed = numfailed + 1
+          if status == 0 then status = runstatus end
+        end
+      end
+    end
+  end
+  if numfailed > 0 then
+    console.errorf("%d of %d inputs failed", numfailed, #builds)
+    if status == 0 then status = 1 end
+  end
+  return status
+end
+
+local function run(args, redirect)
+  load_nelua_init()
+  local options = configer.parse(args) -- parse options
+  -- set lua path and restore it when run ends
+  local oldluapath = package.path
+  package.path = options.lua_path
+  local _ <close> = setmetatable({}, {__close = function()
+    package.path = oldluapath
+  end})
+  -- handle actions that exits early
+  if config.version then
+    return runner.show_version()
+  elseif config.semver then
+    return runner.show_semver()
+  elseif config.config then
+    return runner.show_config(options)
+  elseif config.script then
+    return runner.run_script()
+  end
+  -- setup the garbage collector for compiling, restoring its defaults when run ends
+  memtracker.setup_gc(config.gc, config.max_memory)
+  local _ <close> = setmetatable({}, {__close = function()
+    memtracker.setup_gc()
+  end})
+  -- this is required here because the config may affect how they load
+  local generator = require('nelua.'..config.generator..'generator')
+  local compiler = generator.compiler
+  if config.timing then
+    console.debugf('startup      %.1f ms%s', timer:elapsedrestart(), memtracker.format_phase())
+  end
+  if not config.input then
+    console.error('Missing input, please pass a source file as an argument.')
+    return 1
+  end
+  -- compiling many inputs?
+  if config.jobs then
+    if config.output then
+      console.error('Cannot use an output file when compiling many inputs.')
+      return 1
+    end
+    local inputnames = {config.input}
+    tabler.insertvalues(inputnames, config.runargs)
+    return run_many(inputnames, generator, redirect)
+  end
+  -- determine input
+  local input, inputname = read_input(config.input)
+  local sourcefile, outprefix, context = generate_input(input, inputname, generator)
+  if not sourcefile then
     return 0
   end
   -- compile the generated code
@@ -247,22 +379,22 @@ local function run(args, redirect)
     return 0
   end
   -- execute binary
-  local exe, exeargs = compiler.get_run_command(outfile, config.runargs, context.compileopts)
-  if config.verbose then console.info(exe .. ' ' .. table.concat(exeargs, ' ')) end
-  local _, status = executor.rexec(exe, exeargs, redirect)
-  if config.timing then
-    console.debugf('run          %.1f ms', timer:elapsedrestart())
-  end
-  return status
+  return run_binary(compiler, outfile, config.runargs, context.compileopts, redirect)
 end
 
-function runner.run(args, redirect)
+local function run_once(args, redirect)
   local status
+  dependencies = {}
+  memtracker.reset()
   except.try(function()
     status = run(args, redirect)
     if config.on_finish then config.on_finish() end
     if config.timing then -- show total timing statistics
       console.debug2f('total time   %.1f ms', globaltimer:elapsedrestart())
+      local maxpeak = memtracker.get_max_peak()
+      if maxpeak > 0 then
+        console.debug2f('peak memory  %.1f MB', maxpeak / (1024*1024))
+      end
     end
     tracker.report() -- show tracker statistics in case of any
   end, function(e) -- got a compile error
@@ -279,4 +411,56 @@ function runner.run(args, redirect)
   return status
 end
 
+--[[
+Waits the files read in the last run to change, then runs again in the same process,
+thus modules and caches of the compiler that are still valid are reused.
+Lua modules required by the preprocessor that changed are unloaded to be loaded again.
+Never returns, unless watching files is not supported.
+]]
+local function watch(args, redirect)
+  local sys = _G.sys
+  if not (sys and sys.waitchange) then --luacov:disable
+    console.error('Watching files is not supported on this system.')
+    return 1
+  end --luacov:enable
+  while true do
+    local watchdeps = dependencies
+    local paths = {}
+    for filepath in pairs(watchdeps) do
+      paths[#paths+1] = filepath
+    end
+    if #paths == 0 and config.input and fs.isfile(config.input) then -- failed before analyzing
+      paths[1] = fs.abspath(config.input)
+    end
+    table.sort(paths)
+    if #paths == 0 then
+      console.error('No files to watch.')
+      return 1
+    end
+    console.debugf('watching %d files for changes...', #paths)
+    local changed, err = sys.waitchange(paths)
+    if not changed then --luacov:disable
+      console.errorf('failed to watch files: %s', err)
+      return 1
+    end --luacov:enable
+    for _,filepath in ipairs(changed) do
+      local modname = watchdeps[filepath]
+      if type(modname) == 'string' then
+        package.loaded[modname] = nil
+        package.loaded[filepath] = nil
+      end
+      if config.verbose then console.info('changed ' .. filepath) end
+    end
+    run_once(args, redirect)
+  end
+end
+
+function runner.run(args, redirect)
+  local status = run_once(args, redirect)
+  if config.watch then
+    status = watch(args, redirect)
+  end
+  return status
+end
+
 return runner
@@ -21,7 +21,7 @@ Block           <==(local / global /
                     for /
                     While / Repeat /
                     Break / Continue / Fallthrough /
-                    Goto / Label /
+                    ComputedGoto / Goto / Label /
                     Preprocess /
                     Assign / call /
                     `;`)*
@@ -34,6 +34,7 @@ Break           <== `break`
 Continue        <== `continue`
 Fallthrough     <== `fallthrough`
 Goto            <== `goto` @name
+ComputedGoto    <== `goto` `*` @expr
 Do              <== `do` Block @`end`
 Defer           <== `defer` Block @`end`
 While           <== `while` @expr @`do` Block @`end`
@@ -63,6 +64,7 @@ Boolean         <== `true`->totrue / `false`->tofalse
 Nilptr          <== `nilptr`
 Nil             <== `nil`
 Varargs         <== `...`
+LabelAddr       <== `&&` @name
 Id              <== name
 IdDecl          <== name (`:` @typeexpr)~? annots?
 typeddecl    : IdDecl <== name `:` @typeexpr annots?
@@ -144,7 +146,7 @@ exprfact        <-- (exprunary opfact*)~>foldleft
 exprunary       <-- opunary / exprpow
 exprpow         <-- (exprsimple oppow*)~>foldleft
 exprsimple      <-- Number / String / Type / InitList / Boolean /
-                    Function / Nilptr / Nil / Varargs / exprsuffixed
+                    Function / Nilptr / Nil / Varargs / LabelAddr / exprsuffixed
 exprprim        <-- ppcallprim / id / DoExpr / Paren
 
 -- Types
@@ -223,12 +225,12 @@ EXP_DIGITS      <-- [+-]? DEC_DIGIT+
 -- Comments
 COMMENT         <-- '--' (COMMENT_LONG / COMMENT_SHRT)
 COMMENT_LONG    <-- (LONG_OPEN LONG_CONTENT @LONG_CLOSE)->0
-COMMENT_SHRT    <-- (!LINEBREAK .)*
+COMMENT_SHRT    <-- [^%cn%cr]*
 
 -- Preprocess
 PREPROCESS      <-- '##' (PREPROCESS_LONG / PREPROCESS_SHRT)
 PREPROCESS_LONG <-- {:'[' {:eq: '='*:} '[' {LONG_CONTENT} @LONG_CLOSE:}
-PREPROCESS_SHRT <-- {(!LINEBREAK .)*} LINEBREAK?
+PREPROCESS_SHRT <-- {[^%cn%cr]*} LINEBREAK?
 
 -- Long (used by string, comment and preprocess)
 LONG_CONTENT    <-- (!LONG_CLOSE .)*
@@ -240,7 +242,7 @@ NAME_PREFIX     <-- [_a-zA-Z%utf8seq]
 NAME_SUFFIX     <-- [_a-zA-Z0-9%utf8seq]+
 
 -- Miscellaneous
-SHEBANG         <-- '#!' (!LINEBREAK .)* LINEBREAK?
+SHEBANG         <-- '#!' [^%cn%cr]* LINEBREAK?
 SKIP            <-- (SPACE+ / COMMENT)*
 WORDSKIP        <-- !NAME_SUFFIX SKIP
 LINEBREAK       <-- %cn %cr / %cr %cn / %cn / %cr
@@ -292,6 +292,11 @@ typedefs.pragmas = {
   Please care changing this, as it will change the semantics of many code.
   ]]
   noinit = shaper.optional_boolean,
+  --[[
+  Disables evaluation at compile time of calls to `<comptimeeval>` functions
+  when all arguments are known at compile time.
+  ]]
+  nocomptimeeval = shaper.optional_boolean,
   -- Disable showing the source location in runtime errors (created to have reproducible builds).
   noerrorloc = shaper.optional_boolean,
   -- Disable configuration warning in the C code generation (created to minify the C codegen).
@@ -355,6 +360,10 @@ typedefs.function_annots = {
   noinline = true,
   -- Whether to prevent optimizing the function returns, it uses the 'volatile' qualifier in C.
   volatile = true,
+  -- Whether returns of calls in the function must be tail calls, it uses '__attribute__((musttail))' in C.
+  -- The called functions must have the same argument and return types of the function.
+  -- Compilers without support for it fallback to ordinary calls.
+  musttail = true,
   -- Whether to skip declaring the function in C.
   -- When using this the function must be declared somewhere else, like in a C include or macro.
   nodecl = true,
@@ -364,6 +373,14 @@ typedefs.function_annots = {
   -- A function triggers side effects when it can throw errors or manipulate external variables.
   -- The compiler uses this to know if it should use a strict evaluation order when calling it.
   nosideeffect = true,
+  -- Whether to evaluate calls of the function at compile time when all arguments are known at compile time.
+  -- The function is interpreted while compiling, and the call is left to runtime
+  -- when it does anything only possible at runtime, like using pointers or global variables.
+  comptimeeval = true,
+  -- Whether the function returns a new allocation owned by the garbage collector.
+  -- The compiler uses this to allocate on the stack objects that never escape the caller,
+  -- it's ignored when the GC is disabled.
+  gcalloc = true,
   -- Whether to use the function as the entry point of the application (the C main),
   -- the entry point is called before evaluating any file and is responsible for calling `nelua_main`.
   entrypoint = true,
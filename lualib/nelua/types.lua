@@ -202,9 +202,14 @@ Type.shape = shaper.shape {
   is_string = shaper.optional_boolean,
   is_span = shaper.optional_boolean,
   is_vector = shaper.optional_boolean,
+  is_simd = shaper.optional_boolean,
+  is_soa = shaper.optional_boolean,
   is_sequence = shaper.optional_boolean,
   is_list = shaper.optional_boolean,
   is_hashmap = shaper.optional_boolean,
+  is_btreemap = shaper.optional_boolean,
+  is_constmap = shaper.optional_boolean,
+  is_channel = shaper.optional_boolean,
   is_filestream = shaper.optional_boolean,
   is_time_t = shaper.optional_boolean,
   is_clock_t = shaper.optional_boolean,
@@ -503,7 +508,7 @@ function types.gencodename(name, node)
   local uid
   local srcname
   if node then
-    uid = node.uid
+    uid = node:get_uid()
     srcname = node.src and node.src.name or ''
   else
     gencodename_uid = gencodename_uid + 1
@@ -1118,11 +1123,10 @@ function IntegralType:wrap_value(value)
   if traits.is_integral(value) then
     -- wrap around in case the value is not in range
     if not self:is_inrange(value) then
+      value = bn.bwrap(value, self.bitsize)
       if self.is_signed and value > self.max then
-        -- special case for wrapping signed integers
-        value = -bn.bwrap(-value, self.bitsize)
-      else
-        value = bn.bwrap(value, self.bitsize)
+        -- the sign bit is set, wrap to a negative integer
+        value = value - (bn.one() << self.bitsize)
       end
     end
   else -- must be a float
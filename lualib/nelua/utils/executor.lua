@@ -5,6 +5,7 @@ The executor module is used to execute system commands,
 such as running a C compiler or external applications.
 ]]
 
+local class = require 'nelua.utils.class'
 local tabler = require 'nelua.utils.tabler'
 local pegger = require 'nelua.utils.pegger'
 local platform = require 'nelua.utils.platform'
@@ -13,6 +14,11 @@ local fs = require 'nelua.utils.fs'
 -- luacov:disable
 local executor = {}
 
+-- Native process spawning from the 'sys' module, not available on Windows or plain Lua.
+local sys = _G.sys
+local spawn = sys and sys.spawn
+local waitany = sys and sys.waitany
+
 -- List of common POSIX signals
 local signals = {
   [1] = {name='SIGHUP', desc='Hangup'},
@@ -41,12 +47,20 @@ local function get_signal_errmsg(sigcode)
   return string.format('Killed by signal %d', sigcode)
 end
 
---[[
-Execute a shell command, in a compatible and platform independent way.
-Returns true on success, plus exit reason ("exit" or "signal") and status code.
-]]
-local function execute(cmd)
-  local ok, reason, status = os.execute(cmd)
+-- Append the signal error message for a command killed by a signal to its output.
+local function append_signal_errmsg(output, sigcode)
+  local sigerrmsg = get_signal_errmsg(sigcode)
+  if #output > 0 then
+    if not output:find('\n$') then
+      output = output..'\n'
+    end
+    return output..sigerrmsg..'\n'
+  end
+  return sigerrmsg
+end
+
+-- Normalize the results of `os.execute` or a process file `close` across platforms.
+local function normalize_exit(ok, reason, status)
   if reason == "No error" and status == 0 and platform.is_windows then
     -- os.execute bug in Lua 5.2+ not reporting -1 properly on Windows
     status = -1
@@ -59,6 +73,14 @@ local function execute(cmd)
   end
 end
 
+--[[
+Execute a shell command, in a compatible and platform independent way.
+Returns true on success, plus exit reason ("exit" or "signal") and status code.
+]]
+local function execute(cmd)
+  return normalize_exit(os.execute(cmd))
+end
+
 -- Quote and escape an argument for a command.
 local function quote_arg(argument)
   -- only a single argument
@@ -100,27 +122,59 @@ local function executeex(command, bin)
   fs.deletefile(outfile)
   fs.deletefile(errfile)
   if reason == 'signal' then
-    local sigerrmsg = get_signal_errmsg(status)
-    if #errcontent > 0 then
-      if not errcontent:find('\n$') then
-        errcontent = errcontent..'\n'
-      end
-      errcontent = errcontent..sigerrmsg..'\n'
-    else
-      errcontent = sigerrmsg
-    end
+    errcontent = append_signal_errmsg(errcontent, status)
     status = -1
   end
   return success, status, outcontent, errcontent
 end
 
--- Execute a command capturing the stdour/stderr output if required.
-local function pexec(exe, args, capture)
+-- Build a shell command from an executable and its arguments.
+local function make_command(exe, args)
   local command = quote_arg(exe)
   if args and #args > 0 then
     local strargs = table.concat(tabler.imap(args, quote_arg), ' ')
     command = command .. ' ' .. strargs
   end
+  return command
+end
+
+--[[
+Execute a command without a shell, capturing the stdout/stderr output through pipes if required.
+Returns like `pexec`.
+]]
+local function spawnexec(exe, args, capture)
+  local proc, err = spawn(exe, args, capture and 'capture' or 'inherit')
+  if not proc then
+    err = string.format('%s: %s\n', exe, err)
+    if capture then
+      return false, -1, '', err
+    end
+    io.stderr:write(err)
+    io.stderr:flush()
+    return false, -1
+  end
+  local success, reason, status, outcontent, errcontent = proc:wait()
+  if reason == 'signal' then
+    if capture then
+      errcontent = append_signal_errmsg(errcontent, status)
+    else
+      io.stderr:write(get_signal_errmsg(status), '\n')
+      io.stderr:flush()
+    end
+    status = -1
+  end
+  if capture then
+    return success, status, outcontent, errcontent
+  end
+  return success, status
+end
+
+-- Execute a command capturing the stdour/stderr output if required.
+local function pexec(exe, args, capture)
+  if spawn then
+    return spawnexec(exe, args, capture)
+  end
+  local command = make_command(exe, args)
   if capture then
     return executeex(command)
   else
@@ -214,5 +268,87 @@ function executor.rexec(exe, args, redirect)
   end
 end
 
+--[[
+Process pool, used to execute many commands concurrently.
+At most `maxjobs` commands are kept running at the same time,
+spawning a command on a full pool waits for a running command to finish first.
+The stdout and stderr of each command are captured together.
+]]
+local ProcessPool = class()
+executor.ProcessPool = ProcessPool
+
+function ProcessPool:_init(maxjobs)
+  self.maxjobs = math.max(maxjobs or 1, 1)
+  self.running = {}
+end
+
+--[[
+Spawn a command in the pool.
+Args must be a table or nil, if args is nil then the args is extracted from exe.
+When the command finishes `onfinish` is called with a success flag, the status code and its output.
+]]
+function ProcessPool:spawn(exe, args, onfinish)
+  exe, args = executor.convertargs(exe, args)
+  while #self.running >= self.maxjobs do
+    self:wait()
+  end
+  if spawn then
+    local proc, err = spawn(exe, args, 'merge')
+    if not proc then
+      onfinish(false, -1, string.format('%s: %s\n', exe, err))
+      return
+    end
+    table.insert(self.running, {proc=proc, onfinish=onfinish})
+    return
+  end
+  local command = make_command(exe, args)
+  if not platform.is_windows then
+    -- adding '{' '}' braces captures crash messages
+    command = '{ ' .. command .. '; } 2>&1'
+  else
+    command = command .. ' 2>&1'
+  end
+  local file, err = io.popen(command, 'r')
+  if not file then
+    onfinish(false, -1, err)
+    return
+  end
+  table.insert(self.running, {file=file, onfinish=onfinish})
+end
+
+--[[
+Wait a running command to finish, calling its finish callback.
+When spawning natively the first command to finish is waited, otherwise the oldest one.
+Returns false when there are no commands running.
+]]
+function ProcessPool:wait()
+  if #self.running == 0 then return false end
+  local output, success, reason, status
+  local proc
+  if spawn then
+    local procs = {}
+    for i,running in ipairs(self.running) do
+      procs[i] = running.proc
+    end
+    proc = table.remove(self.running, assert(waitany(procs)))
+    success, reason, status, output = proc.proc:wait()
+  else
+    proc = table.remove(self.running, 1)
+    output = proc.file:read('a') or ''
+    success, reason, status = normalize_exit(proc.file:close())
+  end
+  if reason == 'signal' then
+    output = append_signal_errmsg(output, status)
+    status = -1
+  end
+  proc.onfinish(success, status, output)
+  return true
+end
+
+-- Wait all running commands to finish.
+function ProcessPool:waitall()
+  repeat until not self:wait()
+end
+
 return executor
 -- luacov:enable
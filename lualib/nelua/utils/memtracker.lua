@@ -0,0 +1,168 @@
+--[[
+Memory tracker module
+
+The memory tracker is used to report the compiler memory usage per compile phase
+and to tune the Lua garbage collector for the compiler workload.
+
+Memory usage statistics comes from the allocator of Nelua's Lua interpreter (`sys.memstats`),
+when running in other interpreters they are not available.
+]]
+
+local memtracker = {}
+
+local MB = 1024*1024
+local is_lua54 = _VERSION == 'Lua 5.4'
+
+-- Default garbage collector parameters, tuned to be less aggressive to speed up compilation.
+memtracker.incremental_params = {pause=800, stepmul=400, stepsize=16}
+-- Generational garbage collector parameters, tuned to do less major collections.
+memtracker.generational_params = {minormul=50, majormul=300}
+
+-- Current GC setup and memory in use after the last forced major collection.
+local gcmode = 'incremental'
+local lastmajor = 0
+local maxmemory
+
+-- Highest memory usage seen in phase reports and allocated bytes at the last report.
+local maxpeak = 0
+local lasttotal = 0
+
+-- Get allocator memory statistics, bytes in use, peak bytes in use and total allocated bytes.
+local function get_memstats(reset)
+  local sys = _G.sys
+  if sys and sys.memstats then
+    return sys.memstats(reset)
+  end
+end
+
+-- Resets the statistics used by phase reports.
+function memtracker.reset()
+  local _, _, total = get_memstats(true)
+  maxpeak = 0
+  lasttotal = total or 0
+end
+
+--[[
+Formats memory statistics for the compiler phase that just finished, to be shown in timing reports.
+It contains the peak of memory in use and the amount of memory allocated during the phase.
+Returns an empty string when memory statistics are not available.
+]]
+function memtracker.format_phase()
+  local _, peak, total = get_memstats(true)
+  if not peak then return '' end
+  local allocated = total - lasttotal
+  lasttotal = total
+  maxpeak = math.max(maxpeak, peak)
+  return string.format(' (peak %.1f MB, allocated %.1f MB)', peak / MB, allocated / MB)
+end
+
+-- Returns the highest memory in use seen in phase reports, in bytes.
+function memtracker.get_max_peak()
+  return maxpeak
+end
+
+-- Number of executed Lua instructions between memory budget checks.
+local BUDGET_CHECK_INSTRUCTIONS = 1000000
+
+--[[
+Adjust GC parameters to keep memory usage under the maximum memory budget,
+the more the memory in use approaches the budget, the more aggressive the collector gets.
+Called periodically through a debug count hook, because the collector parameters
+cannot be changed from inside finalizers.
+]]
+local function check_budget()
+  local inuse = collectgarbage('count') * 1024
+  -- headroom ratio before reaching 3/4 of the budget
+  -- (the remaining 1/4 accounts for the collector lagging behind allocations)
+  local ratio = (maxmemory * 0.75) / math.max(inuse, 1)
+  if gcmode == 'generational' then
+    -- minor collections cannot free old objects, so force a major collection when over the budget,
+    -- but only after 25% of growth, otherwise a budget smaller than the live data
+    -- would make the collector run nonstop
+    if ratio < 1 and inuse > lastmajor * 1.25 then
+      collectgarbage()
+      lastmajor = collectgarbage('count') * 1024
+    end
+    return
+  end
+  local params = memtracker.incremental_params
+  -- wait at least 25% of growth between cycles, otherwise a budget
+  -- smaller than the live data would make the collector run nonstop
+  local pause = math.max(math.min(math.floor(ratio * 100), params.pause), 125)
+  -- finish cycles faster when near the budget
+  local stepmul = ratio < 2 and params.stepmul * 2 or params.stepmul
+  collectgarbage('incremental', pause, stepmul, params.stepsize)
+end
+
+-- Debug hook installed before the budget checks (like coverage or profiler hooks), with its mask and count.
+local prevhook, prevmask, prevcount = nil, '', 0
+-- Instructions executed since the last budget check.
+local budgetcount = 0
+
+--[[
+Debug hook that checks the memory budget periodically,
+while forwarding events to the hook installed before it.
+]]
+local function budget_hook(event, line)
+  if event == 'count' then
+    budgetcount = budgetcount + (prevcount > 0 and prevcount or BUDGET_CHECK_INSTRUCTIONS)
+    if budgetcount >= BUDGET_CHECK_INSTRUCTIONS then
+      budgetcount = 0
+      check_budget()
+    end
+    if prevcount == 0 then return end -- the previous hook does not want count events
+  end
+  if prevhook then
+    -- tail call, so the previous hook sees the same stack levels as when installed directly
+    return prevhook(event, line)
+  end
+end
+
+--[[
+Setup the garbage collector for compiling.
+The `mode` can be 'incremental' (default), 'generational' or 'off' (never collect, uses more memory).
+When `budget` (in megabytes) is set, then the collector aggressiveness is
+periodically adjusted to keep the memory in use under it.
+]]
+function memtracker.setup_gc(mode, budget)
+  mode = mode or 'incremental'
+  gcmode = mode
+  maxmemory = budget and budget * MB
+  if debug.gethook() == budget_hook then -- remove previous budget checks, restoring the previous hook
+    if prevhook then
+      debug.sethook(prevhook, prevmask, prevcount)
+    else
+      debug.sethook()
+    end
+    prevhook, prevmask, prevcount = nil, '', 0
+  end
+  if mode == 'off' then
+    collectgarbage('stop')
+    return
+  end
+  collectgarbage('restart')
+  if not is_lua54 then return end
+  if mode == 'generational' then
+    local params = memtracker.generational_params
+    collectgarbage('generational', params.minormul, params.majormul)
+  else
+    local params = memtracker.incremental_params
+    collectgarbage('incremental', params.pause, params.stepmul, params.stepsize)
+  end
+  lastmajor = 0
+  if maxmemory then
+    check_budget()
+    local hook, mask, count = debug.gethook()
+    if hook and type(hook) ~= 'function' then return end -- cannot chain hooks set from C
+    prevhook, prevmask, prevcount = hook, mask or '', count or 0
+    budgetcount = 0
+    debug.sethook(budget_hook, prevmask, prevcount > 0 and prevcount or BUDGET_CHECK_INSTRUCTIONS)
+  end
+end
+
+-- Returns the current garbage collector mode.
+function memtracker.get_gc_mode()
+  return gcmode
+end
+
+return memtracker
@@ -104,4 +104,73 @@ function stringer.ensurenewline(s)
   return s
 end
 
+--[[
+Hash a string mixing its size with its bytes at `positions`.
+Positions are 0 based, negative positions count from the end (-1 is the last byte),
+bytes outside the string count as 0.
+The result is an unsigned 32-bit integer, computed the same way by `switch` statements on strings.
+]]
+function stringer.poshash(s, positions)
+  local size = #s
+  local h = size & 0xffffffff
+  for i=1,#positions do
+    local pos = positions[i]
+    local c = 0
+    if pos >= 0 then
+      if pos < size then c = s:byte(pos+1) end
+    elseif -pos <= size then
+      c = s:byte(size+pos+1)
+    end
+    h = (h * 31 + c) & 0xffffffff
+  end
+  return h
+end
+
+-- Count how many strings in `strs` share their hash with a previous one.
+local function count_poshash_collisions(strs, positions)
+  local seen = {}
+  local collisions = 0
+  for i=1,#strs do
+    local h = stringer.poshash(strs[i], positions)
+    if seen[h] then
+      collisions = collisions + 1
+    else
+      seen[h] = true
+    end
+  end
+  return collisions
+end
+
+--[[
+Choose byte positions for `stringer.poshash` that make the hashes of `strs` unique (a perfect hash).
+Positions are chosen greedily, up to `maxpositions` (default 4),
+for huge or very similar sets the returned positions may still have collisions.
+Returns the positions and the number of collisions.
+]]
+function stringer.perfecthash_positions(strs, maxpositions)
+  maxpositions = maxpositions or 4
+  local maxsize = 0
+  for i=1,#strs do
+    maxsize = math.max(maxsize, #strs[i])
+  end
+  maxsize = math.min(maxsize, 32)
+  local positions = {}
+  local collisions = count_poshash_collisions(strs, positions)
+  while collisions > 0 and #positions < maxpositions do
+    local bestpos, bestcollisions
+    for pos=-maxsize,maxsize-1 do
+      positions[#positions+1] = pos
+      local poscollisions = count_poshash_collisions(strs, positions)
+      positions[#positions] = nil
+      if not bestcollisions or poscollisions < bestcollisions then
+        bestpos, bestcollisions = pos, poscollisions
+      end
+    end
+    if not bestpos or bestcollisions >= collisions then break end -- no improvement
+    positions[#positions+1] = bestpos
+    collisions = bestcollisions
+  end
+  return positions, collisions
+end
+
 return stringer
@@ -200,6 +200,14 @@ function VisitorContext:get_visiting_node(level)
   return nodestack[#nodestack - (level or 0)]
 end
 
+--[[
+Records `filepath` as a file read while compiling, used to watch the files in watch mode.
+Lua modules required by the preprocessor also record their module name `modname`.
+]]
+function VisitorContext:add_dependency(filepath, modname)
+  self.dependencies[fs.abspath(filepath)] = modname or true
+end
+
 -- Gets source directory for the current nodes being visited.
 function VisitorContext:get_visiting_directory()
   local nodestack = self.nodestack
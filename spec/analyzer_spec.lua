@@ -979,9 +979,20 @@ it("switch", function()
     local a = 2
     switch a case 1 then case B then else end
   ]])
+  expect.analyze_ast([[
+    local s: string
+    local B <comptime> = 'b'
+    switch s case 'a' then case B, '' then else end
+  ]])
   expect.analyze_error(
-    "switch 's' case 1 then end",
+    "switch 1.5 case 1 then end",
     'must be convertible to an integral')
+  expect.analyze_error(
+    "local s: string; switch s case 1 then end",
+    'must evaluate to a compile time string value')
+  expect.analyze_error(
+    "local s: string; switch s case 'a' then case 'b', 'a' then end",
+    "duplicate `case` value 'a'")
   expect.analyze_error(
     "local a; switch a case 1 then case 1.1 then else end",
     'must evaluate to a compile time integral value')
@@ -1112,6 +1123,42 @@ it("goto", function()
   expect.analyze_error([[do defer end goto finish end ::finish::]], 'cannot mix `goto` and `defer` statements')
 end)
 
+it("computed goto", function()
+  expect.analyze_ast("local p = &&label goto *p ::label::")
+  expect.analyze_ast("local function f() local p: pointer = &&label ::label:: goto *p end")
+  expect.analyze_error("local p = &&label", "no visible label")
+  expect.analyze_error("::label:: local function f() local p = &&label end", "no visible label")
+  expect.analyze_error("::label:: goto *1", "must be a pointer")
+  expect.analyze_error("::label:: local p = &&label defer end goto *p", 'cannot mix `goto` and `defer` statements')
+end)
+
+it("musttail", function()
+  expect.analyze_ast([[
+    local function f(n: integer): integer <musttail>
+      if n == 0 then return 0 end
+      return f(n - 1)
+    end
+  ]])
+  expect.analyze_error([[
+    local function g(n: integer, m: integer): integer return n end
+    local function f(n: integer): integer <musttail>
+      return g(n, n)
+    end
+  ]], "must have the same argument and return types")
+  expect.analyze_error([[
+    local function g(n: integer): number return n end
+    local function f(n: integer): integer <musttail>
+      return g(n)
+    end
+  ]], "must have the same argument and return types")
+  expect.analyze_error([[
+    local function f(n: integer): integer <musttail>
+      defer end
+      return f(n - 1)
+    end
+  ]], "cannot mix tail calls")
+end)
+
 it("spans", function()
   expect.analyze_ast([[
     require 'span'
@@ -356,6 +356,76 @@ it("fallthrough", function()
   ]])
 end)
 
+it("switch on strings", function()
+  expect.generate_c([[local s: string, f: function(), g: function()
+    switch s
+      case 'a' then
+        f()
+      case 'bc', '' then
+        g()
+    end
+  ]], {
+    "switch(_switchhash_1) {",
+    "if(_switchval_1.size == 2 && memcmp(_switchval_1.data, (char*)\"bc\", 2) == 0) _switchcase_1 = 2;",
+    "if(_switchval_1.size == 0) _switchcase_1 = 2;",
+    "switch(_switchcase_1) {"
+  })
+  expect.run_c([[
+    local function f(s: string): integer
+      local res = 0
+      switch s do
+      case 'get', 'GET' then
+        res = 1
+      case 'post' then
+        res = 2
+        fallthrough
+      case 'put' then
+        res = res + 3
+      case '' then
+        res = 4
+      else
+        res = -1
+      end
+      return res
+    end
+    assert(f('get') == 1 and f('GET') == 1)
+    assert(f('post') == 5)
+    assert(f('put') == 3)
+    assert(f('') == 4)
+    assert(f('pos') == -1 and f('gets') == -1 and f('PUT') == -1)
+    local function g(_switchval: string, _switchcase: string): integer
+      switch _switchval do
+      case 'a' then
+        switch _switchcase do
+        case 'b' then return 2
+        end
+        return 1
+      end
+      return 0
+    end
+    assert(g('a', '') == 1 and g('a', 'b') == 2 and g('b', 'b') == 0)
+  ]])
+  -- many similar cases
+  local cases = {}
+  for i=1,300 do
+    cases[#cases+1] = string.format("case 'key%d_' then return %d case 'key_%d' then return -%d", i, i, i, i)
+  end
+  expect.run_c(string.format([[
+    require 'string'
+    local function g(s: string): integer
+      switch s do
+      %s
+      end
+      return 0
+    end
+    for i=1,300 do
+      assert(g(string.format('key%%d_', i)) == i)
+      assert(g(string.format('key_%%d', i)) == -i)
+    end
+    assert(g('key') == 0 and g('key301_') == 0)
+  ]], table.concat(cases, '\n')))
+end)
+
 it("do", function()
   expect.generate_c("do\n  return\nend", "return 0;\n")
 end)
@@ -513,6 +583,36 @@ it("for", function()
   ]])
 end)
 
+it("bounds checks elimination", function()
+  expect.generate_c("local a: [4]integer; for i=0,<4 do a[i] = i end", "a.v[i] = i;")
+  expect.generate_c("local a: [4]integer; for i=0,<#a do a[i] = i end", "a.v[i] = (int64_t)i;")
+  expect.generate_c("local a: [4]integer; for i=1,3 do a[i] = i end", "a.v[i] = i;")
+  expect.generate_c("local a: [4]integer; for i=0,4 do a[i] = i end", "a.v[nelua_assert_bounds_nlint64(i, 4)] = i;")
+  expect.generate_c("local a: [4]integer; for i=-1,<4 do a[i] = i end",
+    "a.v[nelua_assert_bounds_nlint64(i, 4)] = i;")
+  expect.generate_c("local a: [4]integer; for i=0,<4 do i = 1 a[i] = i end",
+    "a.v[nelua_assert_bounds_nlint64(i, 4)] = i;")
+  expect.generate_c([[
+    require 'span'
+    local function f(s: span(integer)) for i=0,<#s do s[i] = i end end
+    f((@span(integer)){})
+  ]], "s.data[i] = (int64_t)i;")
+  expect.generate_c([[
+    require 'span'
+    local function f(s: span(integer)) for i=0,<#s do s[i] = i s.size = 0 end end
+    f((@span(integer)){})
+  ]], "nelua_span_int64____atindex(s")
+  expect.run_c([[
+    require 'span'
+    local a: [4]integer
+    for i=0,<#a do a[i] = i end
+    local s: span(integer) = a
+    local sum = 0
+    for i=0,<#s do sum = sum + s[i] end
+    assert(sum == 6)
+  ]])
+end)
+
 it("break and continue", function()
   expect.generate_c("while true do break end", "break;")
   expect.generate_c("while true do continue end", "continue;")
@@ -554,6 +654,176 @@ it("goto", function()
   expect.generate_c("::mylabel::\ngoto mylabel", "mylabel:;\n  goto mylabel;")
 end)
 
+it("computed goto", function()
+  expect.generate_c("::mylabel::\nlocal p = &&mylabel\ngoto *p", {
+    "p = NELUA_LABEL_ADDR(mylabel, 1);",
+    "#ifdef NELUA_COMPUTED_GOTO\n  goto *p;\n#else",
+    "case 1: goto mylabel;",
+    "default: nelua_abort();",
+  })
+  local code = [=[
+    local function run(code: *[0]byte): integer
+      local acc: integer, pc: integer = 0, 0
+      local dispatch: [3]pointer = {&&op_inc, &&op_dbl, &&op_halt}
+      goto *dispatch[code[0]]
+    ::op_inc::
+      acc = acc + 1
+      pc = pc + 1
+      goto *dispatch[code[pc]]
+    ::op_dbl::
+      acc = acc * 2
+      pc = pc + 1
+      goto *dispatch[code[pc]]
+    ::op_halt::
+      return acc
+    end
+    local code: [5]byte = {0,0,1,0,2}
+    print(run(&code))
+  ]=]
+  expect.run_c(code, "5")
+  expect.run({'--generator', 'c', '--cflags=-DNELUA_NO_COMPUTED_GOTO', '--eval', code}, "5")
+  expect.run_error({'--generator', 'c', '--cflags=-DNELUA_NO_COMPUTED_GOTO', '--eval', [[
+    ::mylabel::
+    local p: pointer = (@pointer)(2)
+    goto *p
+  ]]})
+end)
+
+it("musttail", function()
+  expect.generate_c([[
+    local function f(n: integer): integer <musttail>
+      if n == 0 then return 0 end
+      return f(n - 1)
+    end
+  ]], "NELUA_MUSTTAIL return f((n - 1));")
+  expect.run_c([=[
+    local Handler: type = @function(*[0]byte, integer, integer): integer
+    local handlers: [3]Handler
+    local function dispatch(code: *[0]byte, pc: integer, acc: integer): integer <musttail>
+      return handlers[code[pc]](code, pc, acc)
+    end
+    local function op_inc(code: *[0]byte, pc: integer, acc: integer): integer <musttail>
+      return dispatch(code, pc + 1, acc + 1)
+    end
+    local function op_dbl(code: *[0]byte, pc: integer, acc: integer): integer <musttail>
+      return dispatch(code, pc + 1, acc * 2)
+    end
+    local function op_halt(code: *[0]byte, pc: integer, acc: integer): integer
+      return acc
+    end
+    handlers = {op_inc, op_dbl, op_halt}
+    local code: [5]byte = {0,0,1,0,2}
+    print(dispatch(&code, 0, 0))
+  ]=], "5")
+end)
+
+it("compile time evaluation", function()
+  expect.generate_c([[
+    local function fact(n: integer): integer <comptimeeval>
+      if n <= 1 then return 1 end
+      return n * fact(n - 1)
+    end
+    local a = fact(10)
+    local n = 5
+    local b = fact(n)
+  ]], {"a = 3628800;", "b = fact(n);"})
+  expect.generate_c([[
+    local function f(x: int8): int8 <comptimeeval> return x * 100 end
+    local a = f(3)
+    local b = (@int8)(300)
+  ]], {"a = 44;", "b = 44;"})
+  expect.generate_c([[
+    local function f(x: integer): integer <comptimeeval> print(x) return x end
+    local a = f(1)
+  ]], "a = f(1);")
+  expect.generate_c([[
+    ## pragmas.nocomptimeeval = true
+    local function f(x: integer): integer <comptimeeval> return x end
+    local a = f(1)
+  ]], "a = f(1);")
+  expect.generate_c([[
+    local function f(x: integer): integer <nosideeffect> return x end
+    local a = f(1)
+  ]], "a = f(1);")
+  expect.generate_c([[
+    local G: integer = 1
+    local function f(n: integer): integer <comptimeeval>
+      local s = 0
+      for i=1,n do s = s + i end
+      return s + G
+    end
+    local function g(n: integer): integer <comptimeeval>
+      local s = 0
+      for i=1,n do s = s + i end
+      return s
+    end
+    local a = f(1000000)
+    local b = g(1000000)
+  ]], {"a = f(1000000);", "b = g(1000000);"})
+  expect.generate_c([[
+    local function sum(n: integer): float32 <comptimeeval>
+      local s: float32 = 0
+      for i=1,n do s = s + 0.1 end
+      return s
+    end
+    local a = sum(1000)
+  ]], "a = 99.9990463f;")
+  expect.run_c([=[
+    local function sum(n: integer): float32 <comptimeeval>
+      local s: float32 = 0
+      for i=1,n do s = s + 0.1 end
+      return s
+    end
+    local function lerp(a: float32, b: float32, t: float32): float32 <comptimeeval>
+      return a + (b - a) * t
+    end
+    local n, t: float32 = 1000, 0.3
+    assert(sum(1000) == sum(n))
+    assert(lerp(1.1, 3.3, 0.3) == lerp(1.1, 3.3, t))
+    print 'ok'
+  ]=], "ok")
+  expect.run_c([=[
+    local function crc32_entry(i: uint32): uint32 <comptimeeval>
+      local c: uint32 = i
+      for j=0,<8 do
+        if c & 1 ~= 0 then
+          c = 0xedb88320 ~ (c >> 1)
+        else
+          c = c >> 1
+        end
+      end
+      return c
+    end
+    local function make_crc_table(): [256]uint32 <comptimeeval>
+      local t: [256]uint32
+      for i=0,<256 do
+        t[i] = crc32_entry(i)
+      end
+      return t
+    end
+    local function classify(c: byte): byte <comptimeeval>
+      local class: byte = 0
+      switch c do
+      case ' '_b, '\t'_b, '\n'_b then class = 1
+      case '0'_b then class = 2
+      end
+      local x: float32 = 0.5
+      while c > '0'_b and c <= '9'_b and not (x > 8) do
+        x = x * 2
+        c = c - 1
+      end
+      return x > 1 and class + 3 or class
+    end
+    local crctable: [256]uint32 <const> = make_crc_table()
+    local C <comptime> = classify('9'_b)
+    local i: uint32 = 7
+    assert(crctable[1] == 0x77073096 and crctable[255] == 0x2d02ef8d)
+    assert(crctable[7] == crc32_entry(i))
+    assert(classify(' '_b) == 1 and classify('0'_b) == 2 and C == 3)
+    print 'ok'
+  ]=], "ok")
+end)
+
 it("variable declaration", function()
   expect.generate_c("local a: integer", "int64_t a;")
   expect.generate_c("local a: integer = 0", "int64_t a = 0;")
@@ -3607,6 +3877,138 @@ it("GC requirements", function()
 }]])
 end)
 
+it("new escape analysis", function()
+  expect.generate_c([[
+    require 'allocators.default'
+    local Point = @record{x: integer, y: integer}
+    local function f(): integer
+      local p = new(Point)
+      p.x = 1
+      local q = new(@integer)
+      $q = p.x
+      local r = new(Point{1, 2})
+      return $q + r.y
+    end
+    f()
+  ]], {
+    "Point_ptr p = (Point[1]){{0}};",
+    "int64_ptr q = (int64_t[1]){0};",
+    "Point_ptr r = (Point[1]){(Point){1, 2}};",
+  })
+  expect.generate_c([[
+    require 'allocators.default'
+    local Point = @record{x: integer, y: integer}
+    local gp: *Point
+    local function g(p: *Point) end
+    local function f(): *Point
+      local a = new(Point)
+      local b = new(Point)
+      local c = new(Point)
+      local d = new(Point)
+      gp = a
+      g(b)
+      local x: *integer = &c.x
+      return d
+    end
+    f()
+  ]], {
+    "Point_ptr a = nelua_new_1(",
+    "Point_ptr b = nelua_new_1(",
+    "Point_ptr c = nelua_new_1(",
+    "Point_ptr d = nelua_new_1(",
+  })
+  config.pragmas.nogc = true
+  expect.generate_c([[
+    require 'allocators.default'
+    local function f(): integer
+      local p = new(@integer)
+      $p = 1
+      return $p
+    end
+    f()
+  ]], "p = nelua_new_1(")
+  config.pragmas.nogc = nil
+  expect.run_c([[
+    require 'allocators.default'
+    local Point = @record{x: integer, y: integer}
+    local function f(n: integer): integer
+      local sum = 0
+      for i=1,n do
+        local p = new(Point)
+        assert(p.x == 0)
+        p.x = i
+        sum = sum + p.x
+      end
+      return sum
+    end
+    assert(f(10) == 55)
+  ]])
+  -- fields and dereferenced values passed to pointer parameters have their address taken
+  expect.generate_c([[
+    require 'allocators.default'
+    local Inner = @record{x: integer}
+    local Outer = @record{inner: Inner}
+    local kept: *Inner
+    local function keep(p: *Inner) kept = p end
+    local function copy(v: Inner) end
+    local function f()
+      local a = new(Outer)
+      local b = new(Inner)
+      local c = new(Outer)
+      keep(a.inner)
+      keep($b)
+      copy(c.inner)
+    end
+    f()
+  ]], {
+    "Outer_ptr a = nelua_new_1(",
+    "Inner_ptr b = nelua_new_2(",
+    "Outer_ptr c = (Outer[1]){{0}};",
+  })
+  expect.run_c([[
+    require 'allocators.default'
+    local Inner = @record{x: integer}
+    local Outer = @record{inner: Inner}
+    local kept: *Inner
+    local function keep(p: *Inner) kept = p end
+    local function make()
+      local o = new(Outer)
+      o.inner.x = 42
+      keep(o.inner)
+    end
+    local function clobber()
+      local a: [64]integer
+      for i=0,<64 do a[i] = 1000+i end
+    end
+    make()
+    clobber()
+    assert(kept.x == 42)
+  ]])
+  -- uses in the top scope of required modules
+  fs.writefile('require_tmp.nelua', [[
+    require 'allocators.default'
+    local Point = @record{x: integer, y: integer}
+    local kept: *Point
+    do
+      local p = new(Point)
+      kept = p
+    end
+    do
+      local p = new(Point)
+      p.x = 1
+      assert(p.x == 1)
+    end
+    return kept
+  ]])
+  expect.generate_c([[
+    require 'require_tmp'
+  ]], {
+    "require_tmp_Point_ptr p = nelua_new_1(",
+    "require_tmp_Point_ptr p = (require_tmp_Point[1]){{0}};",
+  })
+  fs.deletefile('require_tmp.nelua')
+end)
+
 it("concepts", function()
   expect.run_c([=[
     local an_array = #[concept(function(attr)
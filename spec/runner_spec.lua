@@ -189,6 +189,27 @@ it("verbose", function()
   ]]})
 end)
 
+it("compile many inputs in parallel", function()
+  expect.run({'--jobs', '2', 'examples/helloworld.nelua', 'examples/fibonacci.nelua'}, 'hello world')
+  expect.run({'-j', '2', '--binary', 'examples/helloworld.nelua', 'examples/fibonacci.nelua'})
+  expect.run_error({'-j', '2', '--binary', 'examples/helloworld.nelua', 'tests/invalid.nelua'},
+    {'No such file or directory', '1 of 2 inputs failed'})
+  expect.run_error({'-j', '2', '-o', 'helloworld', 'examples/helloworld.nelua'}, 'Cannot use an output file')
+  expect.run_error({'-j', '0', 'examples/helloworld.nelua'}, 'invalid number of jobs')
+  if ccinfo.is_gcc or ccinfo.is_clang then -- cached libraries are not archived again
+    expect.run({'-j', '2', '--static-lib', 'tests/libmylib_static.nelua', 'examples/helloworld.nelua'})
+    expect.run({'-j', '2', '--static-lib', 'tests/libmylib_static.nelua', 'examples/helloworld.nelua'})
+  end
+end)
+
+it("garbage collector options", function()
+  expect.run({'--gc', 'generational', '--max-memory', '512', '--analyze', 'examples/helloworld.nelua'})
+  expect.run({'--gc', 'incremental', '--max-memory', '512', '--analyze', 'examples/helloworld.nelua'})
+  expect.run({'--gc', 'off', 'examples/helloworld.nelua'}, 'hello world')
+  expect.run_error({'--gc', 'invalid', 'examples/helloworld.nelua'}, 'invalid garbage collector mode')
+  expect.run_error({'--max-memory', '0', 'examples/helloworld.nelua'}, 'invalid maximum memory')
+end)
+
 it("version", function()
   expect.run('--version', "Nelua")
   expect.run('--semver', ".")
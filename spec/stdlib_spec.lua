@@ -40,12 +40,18 @@ end)
 it("vector", function()
   expect.run_c_from_file('tests/vector_test.nelua')
 end)
+it("soa", function()
+  expect.run_c_from_file('tests/soa_test.nelua')
+end)
 it("list", function()
   expect.run_c_from_file('tests/list_test.nelua')
 end)
 it("hashmap", function()
   expect.run_c_from_file('tests/hashmap_test.nelua')
 end)
+it("btreemap", function()
+  expect.run_c_from_file('tests/btreemap_test.nelua')
+end)
 it("hash", function()
   expect.run_c_from_file('tests/hash_test.nelua')
 end)
@@ -76,12 +82,48 @@ end)
 it("coroutine", function()
   expect.run_c_from_file('tests/coroutine_test.nelua')
 end)
+it("simd", function()
+  expect.run_c_from_file('tests/simd_test.nelua')
+  expect.run({'--generator', 'c', '-Pnosimd', 'tests/simd_test.nelua'})
+end)
+it("sort", function()
+  expect.run_c_from_file('tests/sort_test.nelua')
+end)
+it("constmap", function()
+  expect.run_c_from_file('tests/constmap_test.nelua')
+  expect.run_error_c([[
+    require 'constmap'
+    local m: constmap(string, integer, {a=1, b=2, ['a']=3})
+  ]], "duplicate constant map key 'a'")
+  expect.run_error_c([[
+    require 'constmap'
+    local m: constmap(integer, integer, {[1]=1, [2]=2, [0x1]=3})
+  ]], "duplicate constant map key '1'")
+end)
 
 local ccinfo = ccompiler.get_cc_info()
 if (ccinfo.is_gcc or ccinfo.is_clang) and not ccinfo.is_wasm and not ccinfo.is_windows then
   it("threads", function()
     expect.run_c_from_file('tests/threads_test.nelua')
   end)
+  it("parallel sort", function()
+    expect.run({'--generator', 'c', '-Pnogc', 'tests/sort_test.nelua'})
+  end)
+  it("threadpool", function()
+    expect.run_c_from_file('tests/threadpool_test.nelua')
+  end)
+  it("channel", function()
+    expect.run_c_from_file('tests/channel_test.nelua')
+  end)
+  it("slab allocator", function()
+    expect.run_c_from_file('tests/slab_test.nelua')
+  end)
+end
+
+if ccinfo.is_linux then
+  it("eventloop", function()
+    expect.run_c_from_file('tests/eventloop_test.nelua')
+  end)
 end
 
 end)
@@ -663,6 +663,18 @@ describe("statement", function()
           n.If{{n.Id{'a'}, n.Block{n.Goto{'mylabel'}}}}
       })
     end)
+    it("computed", function()
+      expect_ast("local p = &&mylabel goto *p ::mylabel::",
+        n.Block{
+          n.VarDecl{'local', {n.IdDecl{'p', false}}, {n.LabelAddr{'mylabel'}}},
+          n.ComputedGoto{n.Id{'p'}},
+          n.Label{'mylabel'}
+      })
+      expect_ast("goto *t[i]",
+        n.Block{
+          n.ComputedGoto{n.KeyIndex{n.Id{'i'}, n.Id{'t'}}}
+      })
+    end)
   end)
 
   describe("variable declaration", function()
@@ -3,6 +3,7 @@ local describe, it = lester.describe, lester.it
 
 local fs = require 'nelua.utils.fs'
 local tabler = require 'nelua.utils.tabler'
+local memtracker = require 'nelua.utils.memtracker'
 
 describe("utils", function()
 
@@ -38,4 +39,26 @@ it("tabler.shallow_compare_nomt", function()
   assert(not tabler.shallow_compare_nomt({a=1}, {a=1,b=2}))
 end)
 
+it("memtracker keeps previous debug hooks", function()
+  local oldhook, oldmask, oldcount = debug.gethook()
+  local gcmode = memtracker.get_gc_mode()
+  local nlines = 0
+  local function hook(event)
+    if event == 'line' then nlines = nlines + 1 end
+  end
+  debug.sethook(hook, 'l')
+  memtracker.setup_gc('incremental', 512)
+  local x = 0
+  for i=1,10 do x = x + i end
+  assert(debug.gethook() ~= hook and x == 55 and nlines > 10)
+  memtracker.setup_gc(gcmode)
+  local restoredhook = debug.gethook()
+  if oldhook then
+    debug.sethook(oldhook, oldmask, oldcount)
+  else
+    debug.sethook()
+  end
+  assert(restoredhook == hook)
+end)
+
 end)
@@ -99,6 +99,26 @@ static int cs_disjoint (const Charset *cs1, const Charset *cs2) {
   return 1;
 }
 
+/*
+** Check whether a charset contains all characters but one or two
+** (e.g., [^\n] or [^\r\n]). In that case, return the excluded
+** characters in '*c1' and '*c2' ('*c2' is -1 when only one is missing).
+*/
+static int cs_allbut (const byte *cs, int *c1, int *c2) {
+  int n = 0;
+  int c;
+  for (c = 0; c <= UCHAR_MAX; c++) {
+    if (!testchar(cs, c)) {
+      if (n == 0) *c1 = c;
+      else if (n == 1) *c2 = c;
+      else return 0;  /* too many excluded chars */
+      n++;
+    }
+  }
+  if (n == 1) *c2 = -1;
+  return n > 0;
+}
+
 
 /*
 ** If 'tree' is a 'char' pattern (TSet, TChar, TAny), convert it into a
@@ -820,7 +840,8 @@ static void coderuntime (CompileState *compst, TTree *tree, int tt) {
 
 /*
 ** Repetion; optimizations:
-** When pattern is a charset, can use special instruction ISpan.
+** When pattern is a charset, can use special instruction ISpan
+** (or ISpanNot, when the charset excludes only one or two chars).
 ** When pattern is head fail, or if it starts with characters that
 ** are disjoint from what follows the repetions, a simple test
 ** is enough (a fail inside the repetition would backtrack to fail
@@ -831,9 +852,16 @@ static void coderuntime (CompileState *compst, TTree *tree, int tt) {
 static void coderep (CompileState *compst, TTree *tree, int opt,
                      const Charset *fl) {
   Charset st;
+  int c1 = 0, c2 = 0;
   if (tocharset(tree, &st)) {
-    addinstruction(compst, ISpan, 0);
-    addcharset(compst, st.cs);
+    if (cs_allbut(st.cs, &c1, &c2)) {
+      int i = addinstruction(compst, ISpanNot, c1);
+      getinstr(compst, i).i.key = c2;
+    }
+    else {
+      addinstruction(compst, ISpan, 0);
+      addcharset(compst, st.cs);
+    }
   }
   else {
     int e1 = getfirst(tree, fullset, &st);
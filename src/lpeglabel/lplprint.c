@@ -56,7 +56,7 @@ void printinst (const Instruction *op, const Instruction *p) {
   const char *const names[] = {
     "any", "char", "set",
     "testany", "testchar", "testset",
-    "span", "utf-range", "behind",
+    "span", "span_not", "utf-range", "behind",
     "ret", "end",
     "choice", "pred_choice", "jmp", "call", "open_call", /* labeled failure */
     "commit", "partial_commit", "back_commit", "failtwice", "fail", "giveup",
@@ -99,6 +99,12 @@ void printinst (const Instruction *op, const Instruction *p) {
       printcharset((p+1)->buff);
       break;
     }
+    case ISpanNot: {
+      printf("'%c' (%02x)", p->i.aux, p->i.aux);
+      if (p->i.key >= 0)
+        printf(" '%c' (%02x)", p->i.key, p->i.key);
+      break;
+    }
     case IOpenCall: {
       printf("-> %d", (p + 1)->offset);
       break;
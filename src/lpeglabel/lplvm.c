@@ -24,6 +24,35 @@
 
 #define getoffset(p)	(((p) + 1)->offset)
 
+
+/*
+** Instruction dispatch. When the compiler supports labels as values,
+** each instruction jumps directly to the code of the next one through
+** a table of label addresses (threaded dispatch), which gives the
+** branch predictor one indirect jump per instruction instead of a
+** single shared one. Otherwise (or compiling with
+** -DLPEG_USE_JUMPTABLE=0) use a plain switch.
+*/
+#if !defined(LPEG_USE_JUMPTABLE)
+#if defined(__GNUC__) && !defined(DEBUG)
+#define LPEG_USE_JUMPTABLE	1
+#else
+#define LPEG_USE_JUMPTABLE	0
+#endif
+#endif
+
+#if LPEG_USE_JUMPTABLE
+#define vmdispatch(o)	goto *disptab[o];
+#define vmcase(l)	L_##l:
+#define vmdefault	L_default
+#define vmnext		goto *disptab[p->i.code]
+#else
+#define vmdispatch(o)	switch ((Opcode)(o))
+#define vmcase(l)	case l:
+#define vmdefault	default
+#define vmnext		continue
+#endif
+
 static const Instruction giveup = {{IGiveup, 0, 0}};
 
 
@@ -200,6 +229,24 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
   byte insidepred = OUTPRED; /* labeled failure: label environment is off inside predicates */
   stack->p = &giveup; stack->s = s; stack->caplevel = 0; stack->labenv = insidepred; stack++;  /* labeled failure */
   *sfail = s; /* labeled failure */
+#if LPEG_USE_JUMPTABLE
+  static const void *const disptab[IEmpty + 1] = {
+    [IAny] = &&L_IAny, [IChar] = &&L_IChar, [ISet] = &&L_ISet,
+    [ITestAny] = &&L_ITestAny, [ITestChar] = &&L_ITestChar,
+    [ITestSet] = &&L_ITestSet, [ISpan] = &&L_ISpan,
+    [ISpanNot] = &&L_ISpanNot, [IUTFR] = &&L_IUTFR,
+    [IBehind] = &&L_IBehind, [IRet] = &&L_IRet, [IEnd] = &&L_IEnd,
+    [IChoice] = &&L_IChoice, [IPredChoice] = &&L_IPredChoice,
+    [IJmp] = &&L_IJmp, [ICall] = &&L_ICall, [IOpenCall] = &&L_default,
+    [ICommit] = &&L_ICommit, [IPartialCommit] = &&L_IPartialCommit,
+    [IBackCommit] = &&L_IBackCommit, [IFailTwice] = &&L_IFailTwice,
+    [IFail] = &&L_IFail, [IGiveup] = &&L_IGiveup,
+    [IFullCapture] = &&L_IFullCapture, [IOpenCapture] = &&L_IOpenCapture,
+    [ICloseCapture] = &&L_ICloseCapture, [ICloseRunTime] = &&L_ICloseRunTime,
+    [IThrow] = &&L_IThrow, [IThrowRec] = &&L_IThrowRec,
+    [IEmpty] = &&L_default
+  };
+#endif
   lua_pushlightuserdata(L, stackbase);
   for (;;) {
 #if defined(DEBUG)
@@ -211,32 +258,32 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
 #endif
     assert(stackidx(ptop) + ndyncap == lua_gettop(L) && ndyncap <= captop);
     assert(insidepred == INPRED || insidepred == OUTPRED);
-    switch ((Opcode)p->i.code) {
-      case IEnd: {
+    vmdispatch(p->i.code) {
+      vmcase(IEnd) {
         assert(stack == getstackbase(L, ptop) + 1);
         capture[captop].kind = Cclose;
         capture[captop].s = NULL;
         return s;
       }
-      case IGiveup: {
+      vmcase(IGiveup) {
         assert(stack == getstackbase(L, ptop));
         return NULL;
       }
-      case IRet: {
+      vmcase(IRet) {
         assert(stack > getstackbase(L, ptop) && (stack - 1)->s == NULL);
         p = (--stack)->p;
-        continue;
+        vmnext;
       }
-      case IAny: {
+      vmcase(IAny) {
         if (s < e) { p++; s++; }
         else {
           *labelf = LFAIL; /* labeled failure */
           updatefarthest(*sfail, s); /*labeled failure */
           goto fail;
         }
-        continue;
+        vmnext;
       }
-      case IUTFR: {
+      vmcase(IUTFR) {
         int codepoint;
         if (s >= e)
           goto fail;
@@ -248,28 +295,28 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           updatefarthest(*sfail, s); /*labeled failure */
           goto fail;
         }
-        continue;
+        vmnext;
       }
-      case ITestAny: {
+      vmcase(ITestAny) {
         if (s < e) p += 2;
         else p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IChar: {
+      vmcase(IChar) {
         if ((byte)*s == p->i.aux && s < e) { p++; s++; }
         else {
           *labelf = LFAIL; /* labeled failure */
           updatefarthest(*sfail, s); /*labeled failure */
           goto fail;
         }
-        continue;
+        vmnext;
       }
-      case ITestChar: {
+      vmcase(ITestChar) {
         if ((byte)*s == p->i.aux && s < e) p += 2;
         else p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case ISet: {
+      vmcase(ISet) {
         int c = (byte)*s;
         if (testchar((p+1)->buff, c) && s < e)
           { p += CHARSETINSTSIZE; s++; }
@@ -278,16 +325,16 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           updatefarthest(*sfail, s); /*labeled failure */
           goto fail;
         }
-        continue;
+        vmnext;
       }
-      case ITestSet: {
+      vmcase(ITestSet) {
         int c = (byte)*s;
         if (testchar((p + 2)->buff, c) && s < e)
           p += 1 + CHARSETINSTSIZE;
         else p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IBehind: {
+      vmcase(IBehind) {
         int n = p->i.aux;
         if (n > s - o) {
           *labelf = LFAIL; /* labeled failure */
@@ -295,21 +342,31 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           goto fail;
         }
         s -= n; p++;
-        continue;
+        vmnext;
       }
-      case ISpan: {
+      vmcase(ISpan) {
         for (; s < e; s++) {
           int c = (byte)*s;
           if (!testchar((p+1)->buff, c)) break;
         }
         p += CHARSETINSTSIZE;
-        continue;
+        vmnext;
+      }
+      vmcase(ISpanNot) {
+        const char *l = (const char *)memchr(s, p->i.aux, e - s);
+        if (l == NULL) l = e;
+        if (p->i.key >= 0) {  /* second excluded char? */
+          const char *l2 = (const char *)memchr(s, p->i.key, l - s);
+          if (l2 != NULL) l = l2;
+        }
+        s = l; p++;
+        vmnext;
       }
-      case IJmp: {
+      vmcase(IJmp) {
         p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IChoice: {
+      vmcase(IChoice) {
         if (stack == stacklimit)
           stack = doublestack(L, &stacklimit, ptop);
         stack->p = p + getoffset(p);
@@ -319,9 +376,9 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
         stack->predchoice = 0; /* labeled failure */
         stack++;
         p += 2;
-        continue;
+        vmnext;
       } 
-      case IPredChoice: { /* labeled failure: new instruction */
+      vmcase(IPredChoice) { /* labeled failure: new instruction */
         if (stack == stacklimit)
           stack = doublestack(L, &stacklimit, ptop);
         stack->p = p + getoffset(p);
@@ -332,31 +389,31 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
         stack++;
         insidepred = INPRED;
         p += 2;
-        continue;
+        vmnext;
       }
-      case ICall: {
+      vmcase(ICall) {
         if (stack == stacklimit)
           stack = doublestack(L, &stacklimit, ptop);
         stack->s = NULL;
         stack->p = p + 2;  /* save return address */
         stack++;
         p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case ICommit: {
+      vmcase(ICommit) {
         assert(stack > getstackbase(L, ptop) && (stack - 1)->s != NULL);
         stack--;
         p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IPartialCommit: {
+      vmcase(IPartialCommit) {
         assert(stack > getstackbase(L, ptop) && (stack - 1)->s != NULL);
         (stack - 1)->s = s;
         (stack - 1)->caplevel = captop;
         p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IBackCommit: {
+      vmcase(IBackCommit) {
         assert(stack > getstackbase(L, ptop) && (stack - 1)->s != NULL);
         s = (--stack)->s;
         insidepred = stack->labenv; /* labeled failure */
@@ -364,9 +421,9 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           ndyncap -= removedyncap(L, capture, stack->caplevel, captop);
         captop = stack->caplevel;
         p += getoffset(p);
-        continue;
+        vmnext;
       }
-      case IThrow: { /* labeled failure */
+      vmcase(IThrow) { /* labeled failure */
         if (insidepred == OUTPRED) {
           *labelf = (p+1)->i.key;
           stack = getstackbase(L, ptop);
@@ -381,7 +438,7 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
         *sfail = s;
         goto fail;
       }
-      case IThrowRec: { /* labeled failure */
+      vmcase(IThrowRec) { /* labeled failure */
         if (insidepred == OUTPRED) {
           *labelf = (p+2)->i.key;
           *sfail = s;
@@ -392,7 +449,7 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           stack->caplevel = captop;
           stack++;
           p += getoffset(p);
-          continue;
+          vmnext;
         } else {
           while (!(stack-1)->predchoice) {
             --stack;
@@ -402,11 +459,11 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
         }
         goto fail;
       }
-      case IFailTwice:
+      vmcase(IFailTwice)
         assert(stack > getstackbase(L, ptop));
         stack--;
         /* go through */
-      case IFail:
+      vmcase(IFail)
       *labelf = LFAIL; /* labeled failure */
       updatefarthest(*sfail, s); /*labeled failure */
       fail: { /* pattern failed: try to backtrack */
@@ -423,9 +480,9 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
 #if defined(DEBUG)
         printf("**FAIL**\n");
 #endif
-        continue;
+        vmnext;
       }
-      case ICloseRunTime: {
+      vmcase(ICloseRunTime) {
         CapState cs;
         int rem, res, n;
         int fr = lua_gettop(L) + 1;  /* stack index of first result */
@@ -455,9 +512,9 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           captop += n + 1;  /* new captures + close group */
         }
         p++;
-        continue;
+        vmnext;
       }
-      case ICloseCapture: {
+      vmcase(ICloseCapture) {
         const char *s1 = s;
         assert(captop > 0);
         /* if possible, turn capture into a full capture */
@@ -465,7 +522,7 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
             s1 - capture[captop - 1].s < UCHAR_MAX) {
           capture[captop - 1].siz = s1 - capture[captop - 1].s + 1;
           p++;
-          continue;
+          vmnext;
         }
         else {
           capture[captop].siz = 1;  /* mark entry as closed */
@@ -473,11 +530,11 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
           goto pushcapture;
         }
       }
-      case IOpenCapture:
+      vmcase(IOpenCapture)
         capture[captop].siz = 0;  /* mark entry as open */
         capture[captop].s = s;
         goto pushcapture;
-      case IFullCapture:
+      vmcase(IFullCapture)
         capture[captop].siz = getoff(p) + 1;  /* save capture size */
         capture[captop].s = s - getoff(p);
         /* goto pushcapture; */
@@ -487,9 +544,9 @@ const char *match (lua_State *L, const char *o, const char *s, const char *e,
         captop++;
         capture = growcap(L, capture, &capsize, captop, 0, ptop);
         p++;
-        continue;
+        vmnext;
       }
-      default: assert(0); return NULL;
+      vmdefault: assert(0); return NULL;
     }
   }
 }
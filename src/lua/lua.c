@@ -661,38 +661,59 @@ static int pmain (lua_State *L) {
 }
 
 #ifdef LUA_USE_RPMALLOC
-
 #include "../srpmalloc/srpmalloc.h"
+#define l_free(ptr)  rpfree(ptr)
+#define l_realloc(ptr,osize,nsize)  rpaligned_realloc(ptr, 16, nsize, osize, 0)
+#else
+#define l_free(ptr)  free(ptr)
+#define l_realloc(ptr,osize,nsize)  ((void)(osize), realloc(ptr, nsize))
+#endif
 
+/*
+** Allocator that keeps track of memory usage statistics,
+** so the compiler can report and control its memory usage.
+*/
 static void *L_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
-  (void)ud;  /* not used */
+  lua_MemStats *stats = (lua_MemStats *)ud;
+  void *newptr;
+  if (ptr == NULL)  /* 'osize' is the kind of object being allocated */
+    osize = 0;
   if (nsize == 0) {
-    rpfree(ptr);
+    l_free(ptr);
+    stats->inuse -= osize;
     return NULL;
   }
-  else
-    return rpaligned_realloc(ptr, 16, nsize, osize, 0);
+  newptr = l_realloc(ptr, osize, nsize);
+  if (newptr != NULL) {
+    stats->inuse += nsize - osize;
+    if (nsize > osize)
+      stats->total += nsize - osize;
+    if (stats->inuse > stats->peak)
+      stats->peak = stats->inuse;
+  }
+  return newptr;
 }
 
+static lua_MemStats memstats;
+
 static lua_State *newstate (void) {
-  lua_State *L = lua_newstate(L_alloc, NULL);
+  lua_State *L = lua_newstate(L_alloc, &memstats);
   if (L) {
     lua_atpanic(L, &panic);
     lua_setwarnf(L, warnfoff, L);  /* default is warnings off */
+    lua_pushlightuserdata(L, &memstats);
+    lua_setfield(L, LUA_REGISTRYINDEX, LUA_MEMSTATSKEY);
   }
   return L;
 }
 
-#endif /* LUA_USE_RPMALLOC */
-
 int main (int argc, char **argv) {
   int status, result;
+  lua_State *L;
 #ifdef LUA_USE_RPMALLOC
   rpmalloc_initialize();
-  lua_State *L = newstate();  /* create state */
-#else
-  lua_State *L = luaL_newstate();  /* create state */
 #endif
+  L = newstate();  /* create state */
   if (L == NULL) {
     l_message(argv[0], "cannot create state: not enough memory");
     return EXIT_FAILURE;
@@ -55,6 +55,16 @@ LUAMOD_API int (luaopen_lfs) (lua_State *L);
 #define LUA_SYSLIBNAME "sys"
 LUAMOD_API int (luaopen_sys) (lua_State *L);
 
+/* memory statistics tracked by the interpreter allocator (read by "sys") */
+typedef struct lua_MemStats {
+  size_t inuse;  /* bytes currently in use */
+  size_t peak;  /* highest value of 'inuse' since last reset */
+  size_t total;  /* cumulative bytes allocated */
+} lua_MemStats;
+
+/* registry key holding a light userdata to the allocator 'lua_MemStats' */
+#define LUA_MEMSTATSKEY "_MEMSTATS"
+
 #define LUA_LPEGLABELLIBNAME "lpeglabel"
 LUAMOD_API int (luaopen_lpeglabel) (lua_State *L);
 
@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200112L
+#define _POSIX_C_SOURCE 200809L
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -162,18 +162,476 @@ int sys_setenv(lua_State* L) {
   return 1;
 }
 
+/*
+** Returns the interpreter allocator memory statistics, bytes currently in use,
+** the peak of bytes in use and the cumulative bytes allocated.
+** When the first argument is true the peak is reset after being read.
+** Returns nothing when the allocator does not track memory.
+*/
+static int sys_memstats(lua_State *L) {
+  lua_MemStats *stats;
+  int reset = lua_toboolean(L, 1);
+  lua_getfield(L, LUA_REGISTRYINDEX, LUA_MEMSTATSKEY);
+  stats = (lua_MemStats *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  if (!stats)
+    return 0;
+  lua_pushinteger(L, (lua_Integer)stats->inuse);
+  lua_pushinteger(L, (lua_Integer)stats->peak);
+  lua_pushinteger(L, (lua_Integer)stats->total);
+  if (reset)
+    stats->peak = stats->inuse;
+  return 3;
+}
+
+#if !defined(_WIN32)
+
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+
+extern char **environ;
+
+#define SYS_PROCESS "sys.process"
+
+typedef struct sys_Buffer {
+  char *data;
+  size_t size;
+  size_t capacity;
+} sys_Buffer;
+
+/* Child process spawned by 'sys.spawn'. */
+typedef struct sys_Process {
+  pid_t pid;
+  int reaped; /* whether the child was waited */
+  int waitstatus; /* status returned by waitpid */
+  int fds[2]; /* read ends of stdout/stderr pipes, -1 when closed or not captured */
+  sys_Buffer outs[2]; /* captured stdout/stderr */
+} sys_Process;
+
+static void sys_closefd(int *fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+/* Reads available bytes from a captured pipe, closing it at end of file. */
+static int sys_process_pump(sys_Process *p, int i) {
+  sys_Buffer *b = &p->outs[i];
+  ssize_t n;
+  if (b->capacity - b->size < 4096) {
+    size_t capacity = b->capacity > 0 ? b->capacity * 2 : 16384;
+    char *data = (char*)realloc(b->data, capacity);
+    if (!data)
+      return 0;
+    b->data = data;
+    b->capacity = capacity;
+  }
+  do {
+    n = read(p->fds[i], b->data + b->size, b->capacity - b->size);
+  } while (n < 0 && errno == EINTR);
+  if (n > 0)
+    b->size += (size_t)n;
+  else
+    sys_closefd(&p->fds[i]);
+  return 1;
+}
+
+/* Waits the child exit, without blocking unless `block` is set. */
+static int sys_process_reap(sys_Process *p, int block) {
+  pid_t res;
+  if (p->reaped)
+    return 1;
+  do {
+    res = waitpid(p->pid, &p->waitstatus, block ? 0 : WNOHANG);
+  } while (res < 0 && errno == EINTR);
+  if (res == p->pid || (res < 0 && errno == ECHILD)) {
+    p->reaped = 1;
+    if (res < 0) /* reaped by someone else, status is lost */
+      p->waitstatus = -1;
+  }
+  return p->reaped;
+}
+
+/*
+** Waits until any of the processes `ps` finishes, reading their captured outputs meanwhile.
+** Returns the index of the finished process, or -1 on errors.
+*/
+static int sys_process_waitany(lua_State *L, sys_Process **ps, int n) {
+  struct pollfd *pfds = (struct pollfd*)lua_newuserdatauv(L, sizeof(struct pollfd) * (size_t)n * 2, 0);
+  int *owners = (int*)lua_newuserdatauv(L, sizeof(int) * (size_t)n * 2, 0);
+  for (;;) {
+    int i, npfds = 0, polling = 0, res;
+    for (i = 0; i < n; i++) {
+      sys_Process *p = ps[i];
+      int j;
+      if (p->fds[0] < 0 && p->fds[1] < 0) {
+        /* all outputs were read, the child is exiting */
+        if (sys_process_reap(p, n == 1))
+          return i;
+        polling = 1;
+        continue;
+      }
+      for (j = 0; j < 2; j++) {
+        if (p->fds[j] >= 0) {
+          pfds[npfds].fd = p->fds[j];
+          pfds[npfds].events = POLLIN;
+          pfds[npfds].revents = 0;
+          owners[npfds] = i*2 + j;
+          npfds++;
+        }
+      }
+    }
+    if (npfds == 0) {
+      /* children without captured outputs, block until any child exits, leaving it waitable */
+      siginfo_t info;
+      memset(&info, 0, sizeof(info));
+      if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) != 0) {
+        if (errno == EINTR || errno == ECHILD) /* no children left are detected when reaping above */
+          continue;
+        return -1;
+      }
+      for (i = 0; i < n; i++) {
+        if (ps[i]->pid == info.si_pid && sys_process_reap(ps[i], 1))
+          return i;
+      }
+      {
+        /* the exited child is not in the list and stays waitable, avoid spinning on it */
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, NULL);
+      }
+      continue;
+    }
+    res = poll(pfds, (nfds_t)npfds, polling ? 1 : -1);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    for (i = 0; i < npfds; i++) {
+      if (pfds[i].revents != 0) {
+        if (!sys_process_pump(ps[owners[i] / 2], owners[i] % 2)) {
+          errno = ENOMEM;
+          return -1;
+        }
+      }
+    }
+  }
+}
+
+static int sys_process_gc(lua_State *L) {
+  sys_Process *p = (sys_Process*)luaL_checkudata(L, 1, SYS_PROCESS);
+  int i;
+  for (i = 0; i < 2; i++) {
+    sys_closefd(&p->fds[i]);
+    free(p->outs[i].data);
+    p->outs[i].data = NULL;
+    p->outs[i].size = p->outs[i].capacity = 0;
+  }
+  if (p->pid > 0)
+    sys_process_reap(p, 0);
+  return 0;
+}
+
+/*
+** Waits the process to finish, reading its captured outputs.
+** Returns like 'os.execute' (success boolean, "exit" or "signal", the exit status or signal number),
+** plus the captured stdout and stderr contents.
+*/
+static int sys_process_wait(lua_State *L) {
+  sys_Process *p = (sys_Process*)luaL_checkudata(L, 1, SYS_PROCESS);
+  if (!p->reaped && sys_process_waitany(L, &p, 1) < 0)
+    return luaL_fileresult(L, 0, NULL);
+  if (p->waitstatus != -1 && WIFSIGNALED(p->waitstatus)) {
+    lua_pushboolean(L, 0);
+    lua_pushliteral(L, "signal");
+    lua_pushinteger(L, WTERMSIG(p->waitstatus));
+  } else {
+    int status = p->waitstatus == -1 ? -1 : WEXITSTATUS(p->waitstatus);
+    lua_pushboolean(L, status == 0);
+    lua_pushliteral(L, "exit");
+    lua_pushinteger(L, status);
+  }
+  lua_pushlstring(L, p->outs[0].data ? p->outs[0].data : "", p->outs[0].size);
+  lua_pushlstring(L, p->outs[1].data ? p->outs[1].data : "", p->outs[1].size);
+  return 5;
+}
+
+/* Returns the process identifier. */
+static int sys_process_getpid(lua_State *L) {
+  sys_Process *p = (sys_Process*)luaL_checkudata(L, 1, SYS_PROCESS);
+  lua_pushinteger(L, (lua_Integer)p->pid);
+  return 1;
+}
+
+/*
+** Spawns the executable `exe` (searched in PATH) with the arguments table `args`,
+** without using a shell. The optional `mode` selects the child standard outputs:
+** "inherit" (default) shares the parent outputs, "capture" captures stdout and stderr separately,
+** "merge" captures stderr together with stdout.
+** Returns a process object, otherwise nil plus an error message and code.
+*/
+static int sys_spawn(lua_State *L) {
+  static const char *const modes[] = {"inherit", "capture", "merge", NULL};
+  const char *exe = luaL_checkstring(L, 1);
+  int mode = luaL_checkoption(L, 3, "inherit", modes);
+  int nargs, i, err = 0;
+  int pipes[2][2] = {{-1, -1}, {-1, -1}};
+  int npipes = mode == 1 ? 2 : (mode == 2 ? 1 : 0);
+  const char **argv;
+  sys_Process *p;
+  posix_spawn_file_actions_t actions;
+  if (!lua_isnoneornil(L, 2))
+    luaL_checktype(L, 2, LUA_TTABLE);
+  nargs = lua_isnoneornil(L, 2) ? 0 : (int)luaL_len(L, 2);
+  argv = (const char**)lua_newuserdatauv(L, sizeof(char*) * (size_t)(nargs + 2), 0);
+  argv[0] = exe;
+  for (i = 1; i <= nargs; i++) {
+    lua_geti(L, 2, i);
+    argv[i] = luaL_checkstring(L, -1);
+    lua_pop(L, 1); /* the string is still referenced by the table */
+  }
+  argv[nargs + 1] = NULL;
+  p = (sys_Process*)lua_newuserdatauv(L, sizeof(sys_Process), 0);
+  memset(p, 0, sizeof(sys_Process));
+  p->fds[0] = p->fds[1] = -1;
+  luaL_setmetatable(L, SYS_PROCESS);
+  for (i = 0; i < npipes; i++) {
+    if (pipe(pipes[i]) != 0) {
+      err = errno;
+      goto cleanup;
+    }
+    /* the pipes must not leak to children spawned concurrently */
+    fcntl(pipes[i][0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipes[i][1], F_SETFD, FD_CLOEXEC);
+  }
+  if ((err = posix_spawn_file_actions_init(&actions)) != 0)
+    goto cleanup;
+  if (npipes >= 1) {
+    posix_spawn_file_actions_adddup2(&actions, pipes[0][1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipes[npipes - 1][1], STDERR_FILENO);
+  }
+  err = posix_spawnp(&p->pid, exe, &actions, NULL, (char *const*)argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0)
+    goto cleanup;
+  for (i = 0; i < npipes; i++) {
+    sys_closefd(&pipes[i][1]);
+    p->fds[i] = pipes[i][0];
+  }
+  return 1;
+cleanup:
+  for (i = 0; i < npipes; i++) {
+    sys_closefd(&pipes[i][0]);
+    sys_closefd(&pipes[i][1]);
+  }
+  p->pid = 0;
+  lua_pushnil(L);
+  lua_pushstring(L, strerror(err));
+  lua_pushinteger(L, err);
+  return 3;
+}
+
+/*
+** Waits until any of the processes in the sequence table `procs` finishes,
+** reading the captured outputs of all of them meanwhile.
+** Returns the index of the finished process, its results can then be retrieved with 'wait'.
+*/
+static int sys_waitany(lua_State *L) {
+  int n, i, index;
+  sys_Process **ps;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  n = (int)luaL_len(L, 1);
+  luaL_argcheck(L, n > 0, 1, "empty process list");
+  ps = (sys_Process**)lua_newuserdatauv(L, sizeof(sys_Process*) * (size_t)n, 0);
+  for (i = 0; i < n; i++) {
+    lua_geti(L, 1, i + 1);
+    ps[i] = (sys_Process*)luaL_checkudata(L, -1, SYS_PROCESS);
+    lua_pop(L, 1);
+  }
+  index = sys_process_waitany(L, ps, n);
+  if (index < 0)
+    return luaL_fileresult(L, 0, NULL);
+  lua_pushinteger(L, index + 1);
+  return 1;
+}
+
+static const struct luaL_Reg sys_process_methods[] = {
+  {"wait", sys_process_wait},
+  {"getpid", sys_process_getpid},
+  {NULL, NULL}
+};
+
+static void sys_createprocessmeta(lua_State *L) {
+  luaL_newmetatable(L, SYS_PROCESS);
+  lua_pushcfunction(L, sys_process_gc);
+  lua_setfield(L, -2, "__gc");
+  luaL_newlib(L, sys_process_methods);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+}
+
+#include <sys/stat.h>
+#if defined(__linux__)
+  #include <sys/inotify.h>
+#endif
+
+/* Milliseconds to wait for more changes after the first one, editors often write files in steps. */
+#define SYS_WATCH_SETTLE_MS 50
+
+/* Appends `path` to the sequence at `resultidx` when not already present in the set at `seenidx`. */
+static void sys_addchanged(lua_State *L, int resultidx, int seenidx, const char *path) {
+  if (lua_getfield(L, seenidx, path) == LUA_TNIL) {
+    lua_pushboolean(L, 1);
+    lua_setfield(L, seenidx, path);
+    lua_pushstring(L, path);
+    lua_seti(L, resultidx, luaL_len(L, resultidx) + 1);
+  }
+  lua_pop(L, 1);
+}
+
+static const char *sys_basename(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+#if defined(__linux__)
+
+/* Waits changes using inotify, watching the directories of the files to follow renames from editors. */
+static int sys_waitchange_native(lua_State *L, const char **paths, int n, int timeoutms, int resultidx, int seenidx) {
+  char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+  int *wds = (int*)lua_newuserdatauv(L, sizeof(int) * (size_t)n, 0);
+  int fd = inotify_init1(IN_CLOEXEC);
+  int i;
+  if (fd < 0)
+    return -1;
+  for (i = 0; i < n; i++) {
+    const char *base = sys_basename(paths[i]);
+    lua_pushlstring(L, paths[i], (size_t)(base - paths[i]));
+    wds[i] = inotify_add_watch(fd, base == paths[i] ? "." : lua_tostring(L, -1),
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    lua_pop(L, 1);
+  }
+  for (;;) {
+    struct pollfd pfd;
+    ssize_t len;
+    char *p;
+    int res;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    res = poll(&pfd, 1, luaL_len(L, resultidx) > 0 ? SYS_WATCH_SETTLE_MS : timeoutms);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      break;
+    len = read(fd, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      break;
+    for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+      const struct inotify_event *ev = (const struct inotify_event*)p;
+      if (ev->len == 0)
+        continue;
+      for (i = 0; i < n; i++) {
+        if (wds[i] == ev->wd && strcmp(sys_basename(paths[i]), ev->name) == 0)
+          sys_addchanged(L, resultidx, seenidx, paths[i]);
+      }
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+#else
+
+/* Waits changes polling the files modification time and size. */
+static int sys_waitchange_native(lua_State *L, const char **paths, int n, int timeoutms, int resultidx, int seenidx) {
+  const int intervalms = 100;
+  struct stat *stats = (struct stat*)lua_newuserdatauv(L, sizeof(struct stat) * (size_t)n, 0);
+  int i, elapsedms = 0;
+  for (i = 0; i < n; i++) {
+    if (stat(paths[i], &stats[i]) != 0)
+      memset(&stats[i], 0, sizeof(struct stat));
+  }
+  while (timeoutms < 0 || elapsedms < timeoutms) {
+    struct timespec ts = {0, intervalms * 1000000L};
+    int changed = luaL_len(L, resultidx) > 0;
+    nanosleep(&ts, NULL);
+    elapsedms += intervalms;
+    for (i = 0; i < n; i++) {
+      struct stat st;
+      if (stat(paths[i], &st) != 0)
+        memset(&st, 0, sizeof(struct stat));
+      if (st.st_mtime != stats[i].st_mtime || st.st_size != stats[i].st_size || st.st_ino != stats[i].st_ino) {
+        stats[i] = st;
+        sys_addchanged(L, resultidx, seenidx, paths[i]);
+      }
+    }
+    if (changed) /* already waited for more changes */
+      break;
+  }
+  return 0;
+}
+
+#endif
+
+/*
+** Waits until any of the files in the sequence table `paths` is modified, created, replaced or removed,
+** or until `timeout` seconds have passed (waits forever when absent or negative).
+** Returns a sequence table with the changed paths, empty on timeout,
+** otherwise nil plus an error message and code.
+*/
+static int sys_waitchange(lua_State *L) {
+  lua_Number timeout = luaL_optnumber(L, 2, -1);
+  int timeoutms = timeout < 0 ? -1 : (int)(timeout * 1000);
+  int n, i, resultidx, seenidx;
+  const char **paths;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  n = (int)luaL_len(L, 1);
+  paths = (const char**)lua_newuserdatauv(L, sizeof(char*) * (size_t)(n > 0 ? n : 1), 0);
+  for (i = 0; i < n; i++) {
+    lua_geti(L, 1, i + 1);
+    paths[i] = luaL_checkstring(L, -1);
+    lua_pop(L, 1); /* the string is still referenced by the table */
+  }
+  lua_newtable(L);
+  resultidx = lua_gettop(L);
+  lua_newtable(L);
+  seenidx = lua_gettop(L);
+  if (sys_waitchange_native(L, paths, n, timeoutms, resultidx, seenidx) != 0)
+    return luaL_fileresult(L, 0, NULL);
+  lua_pushvalue(L, resultidx);
+  return 1;
+}
+
+#endif
+
 static const struct luaL_Reg sys_reg[] = {
   {"nanotime", sys_nanotime},
   {"isatty", sys_isatty},
   {"setenv", sys_setenv},
+  {"memstats", sys_memstats},
 #ifdef SYS_RDTSC
   {"rdtsc", sys_rdtsc},
   {"rdtscp", sys_rdtscp},
+#endif
+#if !defined(_WIN32)
+  {"spawn", sys_spawn},
+  {"waitany", sys_waitany},
+  {"waitchange", sys_waitchange},
 #endif
   {NULL, NULL}
 };
 
 LUAMOD_API int luaopen_sys(lua_State *L){
+#if !defined(_WIN32)
+  sys_createprocessmeta(L);
+#endif
   luaL_newlib(L, sys_reg);
   return 1;
 }